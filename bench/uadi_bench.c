@@ -0,0 +1,293 @@
+/**
+ * @file uadi_bench.c
+ * @brief Throughput and latency benchmark for the iota producer.
+ *
+ * The benchmark claims an iota device and runs two phases:
+ * - throughput: many chunks are in flight and every chunk is pushed back from
+ *   inside the receive callback, which keeps the fill, ring handoff and
+ *   callback dispatch loop of the producer saturated.
+ * - latency: a single chunk is pushed from the main thread and the time until
+ *   its receive callback is measured, which exercises the wakeup path of an
+ *   idle producer.
+ * - cold start: freshly allocated chunks are claimed with and without warmup
+ *   and the slowest chunk of the first pass is reported.
+ * With --trace FILE the chunk lifetime trace of the throughput phases is
+ * written to FILE, each phase overwriting the previous one. With --pool the
+ * throughput phases run on a library owned chunk pool instead of chunks of
+ * the benchmark, with --format they fill half precision or bfloat16 samples
+ * and with --checksum every datapack gets its CRC32C.
+ * It is also the training workload of the UADI_ENABLE_PGO build.
+ */
+
+#include "UaDI_template.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define IOTA_KEY "123e4567-e89b-12d3-a456-426655440000"
+#define INVERSE_IOTA_KEY "e89b4567-123e-12d3-a456-426655440000"
+#define LATENCY_SAMPLES 20000
+
+static int fill_mode = UADI_FILL_AUTO;
+static int wait_strategy = UADI_WAIT_PARK;
+static int delivery = UADI_DELIVERY_INLINE;
+static char const* trace_path = NULL;
+static int pool = 0;
+static int sample_format = UADI_FORMAT_FLOAT32;
+static int checksum = 0;
+
+struct bench_context{
+    uadi_device_handle device;
+    unsigned char* chunks;
+    unsigned long long delivered;
+    int recycle;
+    volatile int done;
+    unsigned long long last_ns;
+    unsigned long long max_gap_ns;
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+static void receive(struct uadi_receive_struct* receive, void* context)
+{
+    struct bench_context* bench = (struct bench_context*)context;
+    if(receive->status != UADI_SUCCESS || !receive->datapack_ptr)
+        return;
+    ++bench->delivered;
+    if(bench->recycle && pool)
+        uadi_release_chunks(bench->device, &receive->datapack_ptr, 1);
+    else if(bench->recycle)
+        uadi_push_chunks(bench->device, &receive->datapack_ptr, 1);
+    else
+        __atomic_store_n(&bench->done, 1, __ATOMIC_RELEASE);
+}
+
+static void receive_cold(struct uadi_receive_struct* receive, void* context)
+{
+    struct bench_context* bench = (struct bench_context*)context;
+    unsigned long long now = now_ns();
+    if(receive->status != UADI_SUCCESS || !receive->datapack_ptr)
+        return;
+    /* The first gap includes the claim itself, where the warmup happens. */
+    if(bench->delivered > 0 && now - bench->last_ns > bench->max_gap_ns)
+        bench->max_gap_ns = now - bench->last_ns;
+    bench->last_ns = now;
+    __atomic_store_n(&bench->delivered, bench->delivered + 1, __ATOMIC_RELEASE);
+}
+
+static int compare_ull(void const* a, void const* b)
+{
+    unsigned long long x = *(unsigned long long const*)a;
+    unsigned long long y = *(unsigned long long const*)b;
+    return (x > y) - (x < y);
+}
+
+static int run_throughput(uadi_lib_handle lib, char const* name, char const* key,
+                          size_t chunk_count, double seconds)
+{
+    struct bench_context bench;
+    struct uadi_device_options options;
+    uadi_chunk_ptr* array;
+    unsigned long long start;
+    unsigned long long elapsed;
+    unsigned long long delivered;
+    size_t i;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.recycle = 1;
+    bench.chunks = (unsigned char*)malloc(chunk_count * UADI_DEFAULT_CHUNK_SIZE);
+    array = (uadi_chunk_ptr*)malloc(chunk_count * sizeof(*array));
+    if(!bench.chunks || !array)
+        return 1;
+    for(i = 0; i < chunk_count; ++i)
+        array[i] = bench.chunks + i * UADI_DEFAULT_CHUNK_SIZE;
+
+    uadi_device_options_init(&options);
+    options.fill_mode = fill_mode;
+    options.wait_strategy = wait_strategy;
+    options.delivery = delivery;
+    if(trace_path)
+        options.trace_events = 1 << 16;
+    if(pool)
+        options.pool_chunks = chunk_count;
+    options.sample_format = sample_format;
+    options.checksum = checksum;
+    start = now_ns();
+    if(uadi_claim_device_ex(lib, &bench.device, key, receive, &bench,
+                            NULL, NULL, array, pool ? 0 : chunk_count, &options) != UADI_SUCCESS){
+        fprintf(stderr, "claiming %s failed\n", key);
+        return 1;
+    }
+    while((double)(now_ns() - start) < seconds * 1e9){
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+    if(trace_path){
+        /* Writing the trace is not part of the measurement. */
+        delivered = __atomic_load_n(&bench.delivered, __ATOMIC_RELAXED);
+        elapsed = now_ns() - start;
+        if(uadi_export_trace(lib, trace_path) != UADI_SUCCESS)
+            fprintf(stderr, "writing the trace to %s failed\n", trace_path);
+        uadi_release_device(bench.device);
+    } else {
+        uadi_release_device(bench.device);
+        delivered = bench.delivered;
+        elapsed = now_ns() - start;
+    }
+
+    printf("throughput  %-8s chunks=%-5zu %12.0f chunks/s %10.1f MiB/s\n",
+           name, chunk_count,
+           (double)delivered * 1e9 / (double)elapsed,
+           (double)delivered * UADI_DEFAULT_CHUNK_SIZE * 1e9
+               / (double)elapsed / (1024.0 * 1024.0));
+    free(array);
+    free(bench.chunks);
+    return 0;
+}
+
+static int run_latency(uadi_lib_handle lib, char const* name, char const* key, size_t samples)
+{
+    struct bench_context bench;
+    struct uadi_device_options options;
+    unsigned long long* latency;
+    uadi_chunk_ptr chunk;
+    size_t i;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.chunks = (unsigned char*)malloc(UADI_DEFAULT_CHUNK_SIZE);
+    latency = (unsigned long long*)malloc(samples * sizeof(*latency));
+    if(!bench.chunks || !latency)
+        return 1;
+    chunk = bench.chunks;
+
+    uadi_device_options_init(&options);
+    options.wait_strategy = wait_strategy;
+    options.delivery = delivery;
+    if(uadi_claim_device_ex(lib, &bench.device, key, receive, &bench,
+                            NULL, NULL, NULL, 0, &options) != UADI_SUCCESS){
+        fprintf(stderr, "claiming %s failed\n", key);
+        return 1;
+    }
+    for(i = 0; i < samples; ++i){
+        unsigned long long start = now_ns();
+        __atomic_store_n(&bench.done, 0, __ATOMIC_RELAXED);
+        uadi_push_chunks(bench.device, &chunk, 1);
+        while(!__atomic_load_n(&bench.done, __ATOMIC_ACQUIRE))
+            sched_yield();
+        latency[i] = now_ns() - start;
+    }
+    uadi_release_device(bench.device);
+
+    qsort(latency, samples, sizeof(*latency), compare_ull);
+    printf("latency     %-8s push->callback p50=%llu ns p99=%llu ns max=%llu ns\n",
+           name, latency[samples / 2], latency[samples * 99 / 100], latency[samples - 1]);
+    free(latency);
+    free(bench.chunks);
+    return 0;
+}
+
+static int run_cold_start(uadi_lib_handle lib, char const* key, size_t chunk_count, int warmup)
+{
+    struct bench_context bench;
+    struct uadi_device_options options;
+    uadi_chunk_ptr* array;
+    unsigned long long claim_ns;
+    size_t i;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.chunks = (unsigned char*)malloc(chunk_count * UADI_DEFAULT_CHUNK_SIZE);
+    array = (uadi_chunk_ptr*)malloc(chunk_count * sizeof(*array));
+    if(!bench.chunks || !array)
+        return 1;
+    for(i = 0; i < chunk_count; ++i)
+        array[i] = bench.chunks + i * UADI_DEFAULT_CHUNK_SIZE;
+
+    uadi_device_options_init(&options);
+    options.warmup = warmup;
+    claim_ns = now_ns();
+    if(uadi_claim_device_ex(lib, &bench.device, key, receive_cold, &bench,
+                            NULL, NULL, array, chunk_count, &options) != UADI_SUCCESS){
+        fprintf(stderr, "claiming %s failed\n", key);
+        return 1;
+    }
+    claim_ns = now_ns() - claim_ns;
+    while(__atomic_load_n(&bench.delivered, __ATOMIC_ACQUIRE) < chunk_count)
+        sched_yield();
+    uadi_release_device(bench.device);
+
+    printf("cold start  %-8s chunks=%-5zu claim=%llu us slowest chunk=%llu us\n",
+           warmup == UADI_WARMUP_NONE ? "no-warm" : "warmup", chunk_count,
+           claim_ns / 1000, bench.max_gap_ns / 1000);
+    free(array);
+    free(bench.chunks);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    uadi_lib_handle lib;
+    double seconds = 1.0;
+    size_t chunk_count = 64;
+    int result = 0;
+    int i;
+
+    for(i = 1; i < argc; ++i){
+        if(strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if(strcmp(argv[i], "--chunks") == 0 && i + 1 < argc)
+            chunk_count = (size_t)strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--fill") == 0 && i + 1 < argc){
+            ++i;
+            fill_mode = strcmp(argv[i], "temporal") == 0 ? UADI_FILL_TEMPORAL
+                      : strcmp(argv[i], "non-temporal") == 0 ? UADI_FILL_NON_TEMPORAL
+                      : UADI_FILL_AUTO;
+        } else if(strcmp(argv[i], "--wait") == 0 && i + 1 < argc){
+            ++i;
+            wait_strategy = strcmp(argv[i], "adaptive") == 0 ? UADI_WAIT_ADAPTIVE
+                          : strcmp(argv[i], "busy-poll") == 0 ? UADI_WAIT_BUSY_POLL
+                          : UADI_WAIT_PARK;
+        } else if(strcmp(argv[i], "--delivery") == 0 && i + 1 < argc){
+            ++i;
+            delivery = strcmp(argv[i], "pool") == 0 ? UADI_DELIVERY_POOL : UADI_DELIVERY_INLINE;
+        } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc){
+            trace_path = argv[++i];
+        } else if(strcmp(argv[i], "--pool") == 0){
+            pool = 1;
+        } else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc){
+            ++i;
+            sample_format = strcmp(argv[i], "f16") == 0 ? UADI_FORMAT_FLOAT16
+                          : strcmp(argv[i], "bf16") == 0 ? UADI_FORMAT_BFLOAT16
+                          : UADI_FORMAT_FLOAT32;
+        } else if(strcmp(argv[i], "--checksum") == 0){
+            checksum = 1;
+        } else {
+            fprintf(stderr, "usage: %s [--seconds S] [--chunks N]"
+                            " [--fill auto|temporal|non-temporal]"
+                            " [--wait park|adaptive|busy-poll]"
+                            " [--delivery inline|pool] [--trace FILE] [--pool]\n"
+                            "       [--format f32|f16|bf16] [--checksum]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(uadi_init(&lib) != UADI_SUCCESS){
+        fprintf(stderr, "uadi_init failed\n");
+        return 1;
+    }
+    result |= run_throughput(lib, "iota", IOTA_KEY, chunk_count, seconds);
+    result |= run_throughput(lib, "inverse", INVERSE_IOTA_KEY, chunk_count, seconds);
+    result |= run_throughput(lib, "iota", IOTA_KEY, 2, seconds / 2);
+    result |= run_latency(lib, "iota", IOTA_KEY, LATENCY_SAMPLES);
+    result |= run_cold_start(lib, IOTA_KEY, 256, UADI_WARMUP_NONE);
+    result |= run_cold_start(lib, IOTA_KEY, 256, UADI_WARMUP_CLAIM);
+    uadi_deinit(lib);
+    return result;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file uadi_startup.c
+ * @brief Load time benchmark for the shared producer library.
+ *
+ * A host loading dozens of producer libraries at boot pays for every one of
+ * them: the dynamic linker maps the library, processes its relocations and
+ * symbol lookups, and the library initializes. The benchmark measures
+ * dlopen, uadi_init and the first uadi_enumerate of the library, then
+ * deinitializes and closes it again, for a number of rounds. The first round
+ * is reported separately, it is the one that pays for page cache misses.
+ */
+
+#include "UaDI_template.h"
+
+#include <dlfcn.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS 200
+
+typedef uadi_status (*init_function)(uadi_lib_handle*);
+typedef uadi_status (*enumerate_function)(uadi_lib_handle, char*, size_t);
+typedef uadi_status (*deinit_function)(uadi_lib_handle);
+
+struct round{
+    unsigned long long dlopen_ns;
+    unsigned long long init_ns;
+    unsigned long long enumerate_ns;
+    unsigned long long total_ns;
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+static int compare_ull(void const* a, void const* b)
+{
+    unsigned long long x = *(unsigned long long const*)a;
+    unsigned long long y = *(unsigned long long const*)b;
+    return (x > y) - (x < y);
+}
+
+/* Median of the field at offset over all rounds. */
+static unsigned long long median_of(struct round const* rounds, size_t offset)
+{
+    static unsigned long long values[ROUNDS];
+    size_t i;
+    for(i = 0; i < ROUNDS; ++i)
+        values[i] = *(unsigned long long const*)((char const*)&rounds[i] + offset);
+    qsort(values, ROUNDS, sizeof(values[0]), compare_ull);
+    return values[ROUNDS / 2];
+}
+
+static int run_round(char const* path, struct round* round)
+{
+    static char device_list[4096];
+    unsigned long long start = now_ns();
+    unsigned long long loaded;
+    unsigned long long initialized;
+    init_function init;
+    enumerate_function enumerate;
+    deinit_function deinit;
+    uadi_lib_handle lib;
+    void* library;
+
+    library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if(!library){
+        fprintf(stderr, "dlopen failed: %s\n", dlerror());
+        return 1;
+    }
+    *(void**)&init = dlsym(library, "uadi_init");
+    *(void**)&enumerate = dlsym(library, "uadi_enumerate");
+    *(void**)&deinit = dlsym(library, "uadi_deinit");
+    if(!init || !enumerate || !deinit){
+        fprintf(stderr, "%s doesn't export the UaDI API\n", path);
+        dlclose(library);
+        return 1;
+    }
+    loaded = now_ns();
+    if(init(&lib) != UADI_SUCCESS){
+        fprintf(stderr, "uadi_init failed\n");
+        dlclose(library);
+        return 1;
+    }
+    initialized = now_ns();
+    if(enumerate(lib, device_list, sizeof(device_list)) != UADI_SUCCESS){
+        fprintf(stderr, "uadi_enumerate failed\n");
+        deinit(lib);
+        dlclose(library);
+        return 1;
+    }
+    round->dlopen_ns = loaded - start;
+    round->init_ns = initialized - loaded;
+    round->enumerate_ns = now_ns() - initialized;
+    round->total_ns = round->dlopen_ns + round->init_ns + round->enumerate_ns;
+    deinit(lib);
+    dlclose(library);
+    return 0;
+}
+
+static void print_round(char const* name, struct round const* round)
+{
+    printf("startup     %-8s dlopen=%8.1f us init=%8.1f us enumerate=%8.1f us total=%8.1f us\n",
+           name, round->dlopen_ns / 1e3, round->init_ns / 1e3,
+           round->enumerate_ns / 1e3, round->total_ns / 1e3);
+}
+
+int main(int argc, char** argv)
+{
+    char const* path = argc > 1 ? argv[1] : UADI_LIBRARY;
+    static struct round rounds[ROUNDS];
+    struct round median;
+    size_t i;
+
+    if(argc > 2 || (argc == 2 && strcmp(argv[1], "--help") == 0)){
+        fprintf(stderr, "usage: %s [LIBRARY]\n", argv[0]);
+        return 2;
+    }
+    for(i = 0; i < ROUNDS; ++i)
+        if(run_round(path, &rounds[i]))
+            return 1;
+    print_round("first", &rounds[0]);
+
+    /* Each phase on its own median, so the phases don't add up exactly. */
+    median.dlopen_ns = median_of(rounds, offsetof(struct round, dlopen_ns));
+    median.init_ns = median_of(rounds, offsetof(struct round, init_ns));
+    median.enumerate_ns = median_of(rounds, offsetof(struct round, enumerate_ns));
+    median.total_ns = median_of(rounds, offsetof(struct round, total_ns));
+    print_round("median", &median);
+    return 0;
+}
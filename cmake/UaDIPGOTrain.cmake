@@ -0,0 +1,57 @@
+# Collects the profile for the UADI_ENABLE_PGO build. Run in script mode by the
+# uadi_pgo_profile target:
+#   cmake -DSOURCE_DIR=... -DBINARY_DIR=... -DPROFILE_DIR=... -DC_COMPILER=...
+#         -DC_COMPILER_ID=... -DBUILD_TYPE=... -DC_FLAGS=...
+#         -DPROFDATA=... -DSTAMP=... -P UaDIPGOTrain.cmake
+#
+# It configures an instrumented build of the library and uadi_bench in
+# BINARY_DIR, runs the benchmark as the training workload and, for Clang,
+# merges the raw profiles into PROFILE_DIR/uadi.profdata.
+
+file(REMOVE_RECURSE "${PROFILE_DIR}")
+file(MAKE_DIRECTORY "${PROFILE_DIR}" "${BINARY_DIR}")
+
+execute_process(
+    COMMAND "${CMAKE_COMMAND}" "${SOURCE_DIR}"
+        "-DCMAKE_C_COMPILER=${C_COMPILER}"
+        "-DCMAKE_BUILD_TYPE=${BUILD_TYPE}"
+        "-DCMAKE_C_FLAGS=${C_FLAGS}"
+        -DUADI_ENABLE_PGO=OFF
+        -DUADI_PGO_PHASE=generate
+        "-DUADI_PGO_PROFILE_DIR=${PROFILE_DIR}"
+        -DUADI_BUILD_STATIC=OFF
+        -DUADI_BUILD_TESTS=OFF
+        -DUADI_BUILD_BENCHMARKS=ON
+    WORKING_DIRECTORY "${BINARY_DIR}"
+    RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "configuring the instrumented UaDI build failed")
+endif()
+
+execute_process(
+    COMMAND "${CMAKE_COMMAND}" --build . --target uadi_bench
+    WORKING_DIRECTORY "${BINARY_DIR}"
+    RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "building the instrumented UaDI failed")
+endif()
+
+execute_process(
+    COMMAND "${BINARY_DIR}/uadi_bench" --seconds 2
+    WORKING_DIRECTORY "${BINARY_DIR}"
+    RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "the PGO training run of uadi_bench failed")
+endif()
+
+if(C_COMPILER_ID MATCHES "Clang")
+    file(GLOB raw_profiles "${PROFILE_DIR}/*.profraw")
+    execute_process(
+        COMMAND "${PROFDATA}" merge -o "${PROFILE_DIR}/uadi.profdata" ${raw_profiles}
+        RESULT_VARIABLE result)
+    if(result)
+        message(FATAL_ERROR "merging the PGO profiles failed")
+    endif()
+endif()
+
+file(WRITE "${STAMP}" "")
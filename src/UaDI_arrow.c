@@ -0,0 +1,141 @@
+/**
+ * @file UaDI_arrow.c
+ * @brief Export of delivered chunks through the Arrow C Data Interface.
+ */
+
+#include "UaDI_arrow.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Metadata keys of the exported schema, in this order. */
+static char const* const metadata_keys[] = {
+    "uadi.sequence",
+    "uadi.timestamp_ns",
+    "uadi.stream_offset",
+    "uadi.flags",
+    "uadi.channels",
+};
+#define METADATA_COUNT (sizeof(metadata_keys) / sizeof(metadata_keys[0]))
+
+/* Longest metadata key, rounded up, and longest decimal value of an
+ * unsigned long long. */
+#define METADATA_KEY_SIZE 24
+#define METADATA_VALUE_SIZE 20
+
+struct exported_array{
+    uadi_device_handle device;
+    uadi_chunk_ptr chunk;
+    unsigned int flags;
+    const void* buffers[2]; /* validity bitmap (none), samples */
+};
+
+struct exported_schema{
+    /* int32 pair count, then per pair int32 length and bytes of key and value */
+    char metadata[sizeof(int32_t) + METADATA_COUNT * (2 * sizeof(int32_t) + METADATA_KEY_SIZE
+                                                         + METADATA_VALUE_SIZE)];
+};
+
+static void release_array(struct ArrowArray* array)
+{
+    struct exported_array* exported = (struct exported_array*)array->private_data;
+    if(exported->flags & UADI_CHUNK_POOLED)
+        uadi_release_chunks(exported->device, &exported->chunk, 1);
+    else
+        uadi_push_chunks(exported->device, &exported->chunk, 1);
+    free(exported);
+    array->release = NULL;
+}
+
+static void release_schema(struct ArrowSchema* schema)
+{
+    free(schema->private_data);
+    schema->release = NULL;
+}
+
+static char* append_string(char* out, char const* string, size_t length)
+{
+    int32_t size = (int32_t)length;
+    memcpy(out, &size, sizeof(size));
+    memcpy(out + sizeof(size), string, length);
+    return out + sizeof(size) + length;
+}
+
+static void write_metadata(char* out, struct uadi_chunk_header const* header)
+{
+    unsigned long long values[METADATA_COUNT];
+    char value[METADATA_VALUE_SIZE + 1];
+    int32_t count = (int32_t)METADATA_COUNT;
+    size_t i;
+
+    values[0] = header->sequence;
+    values[1] = header->timestamp_ns;
+    values[2] = header->stream_offset;
+    values[3] = header->flags;
+    values[4] = 1; /* every device delivers a single channel of floats */
+
+    memcpy(out, &count, sizeof(count));
+    out += sizeof(count);
+    for(i = 0; i < METADATA_COUNT; ++i){
+        out = append_string(out, metadata_keys[i], strlen(metadata_keys[i]));
+        out = append_string(out, value, (size_t)snprintf(value, sizeof(value), "%llu", values[i]));
+    }
+}
+
+static uadi_status export_schema(struct uadi_chunk_header const* header, struct ArrowSchema* schema)
+{
+    struct exported_schema* exported = (struct exported_schema*)malloc(sizeof(*exported));
+    if(!exported)
+        return UADI_INTERNAL_ERROR;
+    write_metadata(exported->metadata, header);
+    memset(schema, 0, sizeof(*schema));
+    schema->format = header->sample_format == UADI_FORMAT_FLOAT16 ? "e" : "f";
+    schema->name = "samples";
+    schema->metadata = exported->metadata;
+    schema->release = release_schema;
+    schema->private_data = exported;
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_export_arrow(
+    uadi_device_handle device_handle,
+    struct uadi_receive_struct const* receive,
+    struct ArrowArray* array,
+    struct ArrowSchema* schema)
+{
+    struct exported_array* exported;
+    uadi_status status;
+
+    if(!device_handle || !receive || !array)
+        return UADI_INVALID_HANDLE;
+    if(!receive->datapack_ptr || !receive->header || receive->status != UADI_SUCCESS)
+        return UADI_ERROR;
+    if((receive->header->flags & UADI_CHUNK_MIRRORED)
+       || receive->header->sample_format == UADI_FORMAT_BFLOAT16)
+        return UADI_NOT_SUPPORTED;
+
+    exported = (struct exported_array*)malloc(sizeof(*exported));
+    if(!exported)
+        return UADI_INTERNAL_ERROR;
+    if(schema){
+        status = export_schema(receive->header, schema);
+        if(status != UADI_SUCCESS){
+            free(exported);
+            return status;
+        }
+    }
+    exported->device = device_handle;
+    exported->chunk = receive->datapack_ptr;
+    exported->flags = receive->header->flags;
+    exported->buffers[0] = NULL;
+    exported->buffers[1] = receive->datapack_ptr;
+
+    memset(array, 0, sizeof(*array));
+    array->length = (int64_t)receive->header->sample_count;
+    array->n_buffers = 2;
+    array->buffers = exported->buffers;
+    array->release = release_array;
+    array->private_data = exported;
+    return UADI_SUCCESS;
+}
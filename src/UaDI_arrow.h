@@ -0,0 +1,93 @@
+/**
+ * @file UaDI_arrow.h
+ * @brief Export of delivered chunks through the Arrow C Data Interface.
+ *
+ * Columnar consumers speaking Apache Arrow can take a datapack over without
+ * copying it. The exported array references the chunk itself, and releasing
+ * the array gives the chunk back to its device. No Arrow library is needed,
+ * the C Data Interface consists of the two plain structures below, which are
+ * only defined here if the consumer hasn't defined them already.
+ */
+
+#ifndef UADI_ARROW_H
+#define UADI_ARROW_H
+
+#include "UaDI_template.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema{
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray{
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+/**
+ * @brief This function exports a delivered datapack as an Arrow array.
+ * @param device_handle the device handle the datapack was delivered by.
+ * @param receive The receive struct passed to the receive callback.
+ * @param array Receives the array, a float32 or float16 column of the samples.
+ * @param schema Receives the schema of the array, may be NULL.
+ * @return uadi_status UADI_ERROR for an infopack or a failed datapack and
+ * UADI_NOT_SUPPORTED for datapacks of a mirrored ring, which are only valid
+ * until the callback returns, and for bfloat16 samples, which Arrow has no
+ * type for.
+ * @see uadi_receive_callback
+ * Must be called from within the receive callback. The array references the
+ * datapack without copying it, the chunk is owned by the array from then on
+ * and the consumer must not push it itself. The release callback of the
+ * array gives the chunk back to the device with uadi_push_chunks(...), or
+ * with uadi_release_chunks(...) for pool chunks, so the thread safety of those
+ * functions applies to releasing the arrays of a device. Every array has to
+ * be released before the device is.
+ * The schema describes one non-nullable float32 ("f") or float16 ("e")
+ * column named "samples". Its metadata carries the chunk header as decimal
+ * strings under the keys "uadi.sequence", "uadi.timestamp_ns",
+ * "uadi.stream_offset" and "uadi.flags", and the channel layout as
+ * "uadi.channels". The schema doesn't reference the chunk and may outlive
+ * the array.
+ * Thread safety: the same as for the receive callback it is called from.
+ */
+DLL_EXPORT uadi_status uadi_export_arrow(
+    uadi_device_handle device_handle,
+    struct uadi_receive_struct const* receive,
+    struct ArrowArray* array,
+    struct ArrowSchema* schema);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UADI_ARROW_H
@@ -0,0 +1,62 @@
+/**
+ * @file UaDI_driver.h
+ * @brief Interface between the UaDI producer core and the device drivers.
+ *
+ * The core (UaDI_template.c) implements the whole consumer facing API: the
+ * claim and release semantics, the lock-free free ring, the producer
+ * threads, pacing, delivery, statistics, tracing and all options of
+ * struct uadi_device_options. A driver only describes its devices and
+ * fills chunks. To add a device, implement a struct uadi_driver in its own
+ * source file, declare it below and list it in the driver table of
+ * UaDI_template.c. UaDI_iota.c is the reference driver.
+ *
+ * open runs before and close after every other callback of the device, on
+ * the threads claiming and releasing it. fill_chunk is only called by the
+ * producer of the device, never concurrently with itself. control runs on
+ * any thread calling uadi_send_json(...), concurrently with fill_chunk and
+ * with other control calls of the device; drivers whose control commands
+ * change how chunks are filled have to synchronize that themselves.
+ */
+
+#ifndef UADI_DRIVER_H
+#define UADI_DRIVER_H
+
+#include "UaDI_template.h"
+
+#include <stddef.h>
+
+struct uadi_driver{
+    char const* key;         // device key passed to uadi_claim_device
+    char const* vendor;
+    char const* description;
+    size_t chunk_alignment;  // of pool chunks (power of two up to a page), 0 for a cache line
+    unsigned int sample_formats; // 1u << UADI_FORMAT_* filled besides float32
+
+    /* Creates the per-device state at claim time, before the producer starts.
+     * options holds the validated options of the device. May be NULL for
+     * drivers without state. A status other than UADI_SUCCESS fails the
+     * claim. */
+    uadi_status (*open)(struct uadi_device_options const* options, void** state);
+
+    /* Fills chunk_size bytes of samples. With non_temporal set the driver
+     * should write with non-temporal stores and fence them (see
+     * UaDI_kernels.h), the chunk won't be read by the producer again. header
+     * has sequence, timestamp_ns, stream_offset, data_size, sample_count,
+     * sample_format and flags filled in and may be amended, e.g. with flags from
+     * UADI_CHUNK_DRIVER on. A status other than UADI_SUCCESS is delivered in
+     * the status of the receive struct. */
+    uadi_status (*fill_chunk)(void* state, unsigned char* chunk, size_t chunk_size,
+                              int non_temporal, struct uadi_chunk_header* header);
+
+    /* Handles a JSON command of uadi_send_json(...) the core doesn't handle.
+     * May be NULL, the command is then rejected with UADI_NOT_SUPPORTED. */
+    uadi_status (*control)(void* state, char const* json);
+
+    /* Frees the state after the device stopped. May be NULL. */
+    void (*close)(void* state);
+};
+
+extern struct uadi_driver const uadi_iota_driver;
+extern struct uadi_driver const uadi_inverse_iota_driver;
+
+#endif // UADI_DRIVER_H
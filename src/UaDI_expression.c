@@ -0,0 +1,472 @@
+/**
+ * @file UaDI_expression.c
+ * @brief Recursive descent compiler and block interpreter of channel math.
+ */
+
+#include "UaDI_expression.h"
+#include "UaDI_json.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Frames per interpreted block, the stack then fits into the L1 cache. */
+#define EXPRESSION_BLOCK 256
+#define EXPRESSION_MAX_NESTING 64
+
+enum opcode{
+    OP_CHANNEL,  /* push a channel of the frames */
+    OP_CONSTANT, /* push a constant */
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MIN,
+    OP_MAX,
+    OP_NEGATE,   /* unary operations from here on */
+    OP_ABS,
+    OP_SQRT,
+    OP_SCALE     /* constant * x + offset */
+};
+
+/* Added to a binary opcode for the variant with a constant right operand */
+#define IMMEDIATE 16
+
+struct instruction{
+    unsigned char opcode;
+    unsigned char immediate; /* binary operation with constant as right operand */
+    unsigned short channel;
+    float constant;
+    float offset;
+};
+
+struct uadi_expression{
+    size_t channel_count;
+    size_t instruction_count;
+    struct instruction instructions[UADI_EXPRESSION_MAX_INSTRUCTIONS];
+    float stack[UADI_EXPRESSION_MAX_DEPTH][EXPRESSION_BLOCK];
+};
+
+struct compiler{
+    char const* at;
+    char const* const* channels;
+    size_t channel_count;
+    struct uadi_expression* expression;
+    size_t depth; /* stack depth after the instructions emitted so far */
+    int nesting;  /* recursion depth of the parser */
+};
+
+static float apply(int opcode, float a, float b)
+{
+    switch(opcode){
+    case OP_ADD: return a + b;
+    case OP_SUBTRACT: return a - b;
+    case OP_MULTIPLY: return a * b;
+    case OP_DIVIDE: return a / b;
+    case OP_MIN: return b < a ? b : a;
+    case OP_MAX: return b > a ? b : a;
+    case OP_NEGATE: return -a;
+    case OP_ABS: return fabsf(a);
+    default: return sqrtf(a);
+    }
+}
+
+static int is_constant(struct instruction const* instruction)
+{
+    return instruction->opcode == OP_CONSTANT;
+}
+
+static struct instruction* append(struct compiler* compiler, int opcode)
+{
+    struct uadi_expression* expression = compiler->expression;
+    struct instruction* instruction;
+
+    if(expression->instruction_count == UADI_EXPRESSION_MAX_INSTRUCTIONS)
+        return NULL;
+    instruction = expression->instructions + expression->instruction_count++;
+    memset(instruction, 0, sizeof(*instruction));
+    instruction->opcode = (unsigned char)opcode;
+    return instruction;
+}
+
+/* Emits a push or a unary operation, folding operations on constants. */
+static int emit(struct compiler* compiler, int opcode, unsigned short channel, float constant)
+{
+    struct uadi_expression* expression = compiler->expression;
+    struct instruction* instruction;
+
+    if(opcode >= OP_NEGATE){
+        /* The operand is complete, a constant is its only instruction. */
+        instruction = expression->instructions + expression->instruction_count - 1;
+        if(is_constant(instruction)){
+            instruction->constant = apply(opcode, instruction->constant, 0.0f);
+            return 1;
+        }
+    } else if(++compiler->depth > UADI_EXPRESSION_MAX_DEPTH){
+        return 0;
+    }
+    instruction = append(compiler, opcode);
+    if(!instruction)
+        return 0;
+    instruction->channel = channel;
+    instruction->constant = constant;
+    return 1;
+}
+
+/* Emits a binary operation on the operands starting at instruction left and
+ * right. Constant operands are folded, moved into the instruction, for
+ * commutative operations also from the left, and a multiplication followed
+ * by an addition of constants becomes a single scale instruction. */
+static int emit_binary(struct compiler* compiler, int opcode, size_t left, size_t right)
+{
+    struct uadi_expression* expression = compiler->expression;
+    struct instruction* instructions = expression->instructions;
+    size_t count = expression->instruction_count;
+    int commutative = opcode == OP_ADD || opcode == OP_MULTIPLY || opcode == OP_MIN || opcode == OP_MAX;
+    struct instruction* instruction;
+    float constant;
+
+    --compiler->depth;
+    if(right == left + 1 && is_constant(&instructions[left])
+       && right + 1 == count && is_constant(&instructions[right])){
+        instructions[left].constant = apply(opcode, instructions[left].constant, instructions[right].constant);
+        --expression->instruction_count;
+        return 1;
+    }
+    if(right + 1 == count && is_constant(&instructions[right])){
+        constant = instructions[right].constant;
+        --expression->instruction_count;
+    } else if(commutative && right == left + 1 && is_constant(&instructions[left])){
+        constant = instructions[left].constant;
+        memmove(instructions + left, instructions + right, (count - right) * sizeof(*instructions));
+        --expression->instruction_count;
+    } else {
+        return append(compiler, opcode) != NULL;
+    }
+
+    /* The operation now applies a constant to the top of the stack, which
+     * the last instruction left there. */
+    instruction = instructions + expression->instruction_count - 1;
+    if((opcode == OP_ADD || opcode == OP_SUBTRACT)
+       && (instruction->opcode == OP_SCALE
+           || (instruction->opcode == OP_MULTIPLY && instruction->immediate))){
+        instruction->offset += opcode == OP_ADD ? constant : -constant;
+        instruction->opcode = OP_SCALE;
+        instruction->immediate = 0;
+        return 1;
+    }
+    instruction = append(compiler, opcode);
+    if(!instruction)
+        return 0;
+    instruction->immediate = 1;
+    instruction->constant = constant;
+    return 1;
+}
+
+static void skip_space(struct compiler* compiler)
+{
+    while(isspace((unsigned char)*compiler->at))
+        ++compiler->at;
+}
+
+static int accept(struct compiler* compiler, char c)
+{
+    skip_space(compiler);
+    if(*compiler->at != c)
+        return 0;
+    ++compiler->at;
+    return 1;
+}
+
+static int parse_sum(struct compiler* compiler);
+
+/* Parses count comma separated arguments in parentheses, emitting opcode
+ * after the second one and second_opcode after the third one. */
+static int parse_arguments(struct compiler* compiler, int count, int opcode, int second_opcode)
+{
+    size_t left = compiler->expression->instruction_count;
+    size_t right;
+    int i;
+
+    if(!accept(compiler, '('))
+        return 0;
+    for(i = 0; i < count; ++i){
+        right = compiler->expression->instruction_count;
+        if((i && !accept(compiler, ',')) || !parse_sum(compiler))
+            return 0;
+        if((i == 1 && !emit_binary(compiler, opcode, left, right))
+           || (i == 2 && !emit_binary(compiler, second_opcode, left, right)))
+            return 0;
+    }
+    return accept(compiler, ')') && (count != 1 || emit(compiler, opcode, 0, 0.0f));
+}
+
+static int parse_name(struct compiler* compiler)
+{
+    char const* begin = compiler->at;
+    size_t length;
+    size_t i;
+
+    while(isalnum((unsigned char)*compiler->at) || *compiler->at == '_')
+        ++compiler->at;
+    length = (size_t)(compiler->at - begin);
+    skip_space(compiler);
+    if(*compiler->at == '('){
+        if(length == 3 && strncmp(begin, "abs", 3) == 0)
+            return parse_arguments(compiler, 1, OP_ABS, 0);
+        if(length == 4 && strncmp(begin, "sqrt", 4) == 0)
+            return parse_arguments(compiler, 1, OP_SQRT, 0);
+        if(length == 3 && strncmp(begin, "min", 3) == 0)
+            return parse_arguments(compiler, 2, OP_MIN, 0);
+        if(length == 3 && strncmp(begin, "max", 3) == 0)
+            return parse_arguments(compiler, 2, OP_MAX, 0);
+        if(length == 5 && strncmp(begin, "clamp", 5) == 0)
+            return parse_arguments(compiler, 3, OP_MAX, OP_MIN);
+        return 0;
+    }
+    for(i = 0; i < compiler->channel_count; ++i)
+        if(strlen(compiler->channels[i]) == length && strncmp(begin, compiler->channels[i], length) == 0)
+            return emit(compiler, OP_CHANNEL, (unsigned short)i, 0.0f);
+    return 0;
+}
+
+static int parse_primary(struct compiler* compiler)
+{
+    char const* end;
+    double number;
+
+    skip_space(compiler);
+    if(accept(compiler, '('))
+        return parse_sum(compiler) && accept(compiler, ')');
+    if(isalpha((unsigned char)*compiler->at) || *compiler->at == '_')
+        return parse_name(compiler);
+    end = uadi_json_scan_number(compiler->at, &number);
+    if(!end)
+        return 0;
+    compiler->at = end;
+    return emit(compiler, OP_CONSTANT, 0, (float)number);
+}
+
+static int parse_unary(struct compiler* compiler)
+{
+    int parsed;
+    if(++compiler->nesting > EXPRESSION_MAX_NESTING)
+        return 0;
+    if(accept(compiler, '-'))
+        parsed = parse_unary(compiler) && emit(compiler, OP_NEGATE, 0, 0.0f);
+    else if(accept(compiler, '+'))
+        parsed = parse_unary(compiler);
+    else
+        parsed = parse_primary(compiler);
+    --compiler->nesting;
+    return parsed;
+}
+
+static int parse_product(struct compiler* compiler)
+{
+    size_t left = compiler->expression->instruction_count;
+    size_t right;
+    int opcode;
+
+    if(!parse_unary(compiler))
+        return 0;
+    for(;;){
+        if(accept(compiler, '*'))
+            opcode = OP_MULTIPLY;
+        else if(accept(compiler, '/'))
+            opcode = OP_DIVIDE;
+        else
+            return 1;
+        right = compiler->expression->instruction_count;
+        if(!parse_unary(compiler) || !emit_binary(compiler, opcode, left, right))
+            return 0;
+    }
+}
+
+static int parse_sum(struct compiler* compiler)
+{
+    size_t left = compiler->expression->instruction_count;
+    size_t right;
+    int opcode;
+
+    if(!parse_product(compiler))
+        return 0;
+    for(;;){
+        if(accept(compiler, '+'))
+            opcode = OP_ADD;
+        else if(accept(compiler, '-'))
+            opcode = OP_SUBTRACT;
+        else
+            return 1;
+        right = compiler->expression->instruction_count;
+        if(!parse_product(compiler) || !emit_binary(compiler, opcode, left, right))
+            return 0;
+    }
+}
+
+uadi_status uadi_expression_compile(char const* text, char const* const* channels,
+                                    size_t channel_count, struct uadi_expression** expression)
+{
+    struct compiler compiler;
+
+    if(!text || !channel_count || channel_count > UADI_EXPRESSION_MAX_CHANNELS)
+        return UADI_ERROR;
+    compiler.at = text;
+    compiler.channels = channels;
+    compiler.channel_count = channel_count;
+    compiler.depth = 0;
+    compiler.nesting = 0;
+    compiler.expression = (struct uadi_expression*)calloc(1, sizeof(*compiler.expression));
+    if(!compiler.expression)
+        return UADI_INTERNAL_ERROR;
+    compiler.expression->channel_count = channel_count;
+    if(!parse_sum(&compiler) || (skip_space(&compiler), *compiler.at)){
+        free(compiler.expression);
+        return UADI_ERROR;
+    }
+    *expression = compiler.expression;
+    return UADI_SUCCESS;
+}
+
+void uadi_expression_destroy(struct uadi_expression* expression)
+{
+    free(expression);
+}
+
+/* The operations always run over a whole block with distinct operands,
+ * a fixed trip count and no aliasing the compiler has to check for, so even
+ * the cheapest vectorizer cost model turns them into SIMD loops. Lanes past
+ * the frames of a partial block hold zeros. */
+static void operate(int opcode, float* restrict a, float const* restrict b, float k, float offset)
+{
+    size_t i;
+    switch(opcode){
+    case OP_ADD:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] += b[i];
+        break;
+    case OP_SUBTRACT:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] -= b[i];
+        break;
+    case OP_MULTIPLY:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] *= b[i];
+        break;
+    case OP_DIVIDE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] /= b[i];
+        break;
+    case OP_MIN:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = b[i] < a[i] ? b[i] : a[i];
+        break;
+    case OP_MAX:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = b[i] > a[i] ? b[i] : a[i];
+        break;
+    case OP_ADD + IMMEDIATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] += k;
+        break;
+    case OP_SUBTRACT + IMMEDIATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] -= k;
+        break;
+    case OP_MULTIPLY + IMMEDIATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] *= k;
+        break;
+    case OP_DIVIDE + IMMEDIATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] /= k;
+        break;
+    case OP_MIN + IMMEDIATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = k < a[i] ? k : a[i];
+        break;
+    case OP_MAX + IMMEDIATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = k > a[i] ? k : a[i];
+        break;
+    case OP_NEGATE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = -a[i];
+        break;
+    case OP_ABS:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = fabsf(a[i]);
+        break;
+    case OP_SQRT:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = sqrtf(a[i]);
+        break;
+    case OP_SCALE:
+        for(i = 0; i < EXPRESSION_BLOCK; ++i)
+            a[i] = k * a[i] + offset;
+        break;
+    }
+}
+
+static void load_channel(float* restrict a, float const* restrict channel,
+                         size_t channels, size_t count)
+{
+    size_t i;
+    if(channels == 1){
+        memcpy(a, channel, count * sizeof(float));
+    } else {
+        for(i = 0; i < count; ++i)
+            a[i] = channel[i * channels];
+    }
+    memset(a + count, 0, (EXPRESSION_BLOCK - count) * sizeof(float));
+}
+
+static void evaluate_block(struct uadi_expression* expression, float* out,
+                           float const* frames, size_t count)
+{
+    struct instruction const* instruction = expression->instructions;
+    struct instruction const* end = instruction + expression->instruction_count;
+    size_t top = 0;
+    size_t i;
+
+    for(; instruction < end; ++instruction){
+        switch(instruction->opcode){
+        case OP_CHANNEL:
+            load_channel(expression->stack[top++], frames + instruction->channel,
+                         expression->channel_count, count);
+            break;
+        case OP_CONSTANT:
+            for(i = 0; i < EXPRESSION_BLOCK; ++i)
+                expression->stack[top][i] = instruction->constant;
+            ++top;
+            break;
+        default:
+            if(instruction->opcode >= OP_NEGATE || instruction->immediate){
+                operate(instruction->opcode + (instruction->immediate ? IMMEDIATE : 0),
+                        expression->stack[top - 1], NULL, instruction->constant,
+                        instruction->offset);
+            } else {
+                --top;
+                operate(instruction->opcode, expression->stack[top - 1],
+                        expression->stack[top], 0.0f, 0.0f);
+            }
+            break;
+        }
+    }
+    memcpy(out, expression->stack[0], count * sizeof(float));
+}
+
+/* Every block writes its results only after reading its frames and never
+ * beyond the frames of the next block, so out may alias frames. */
+void uadi_expression_evaluate(struct uadi_expression* expression, float* out,
+                              float const* frames, size_t frame_count)
+{
+    size_t count;
+    for(; frame_count; frame_count -= count){
+        count = frame_count < EXPRESSION_BLOCK ? frame_count : EXPRESSION_BLOCK;
+        evaluate_block(expression, out, frames, count);
+        out += count;
+        frames += count * expression->channel_count;
+    }
+}
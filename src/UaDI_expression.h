@@ -0,0 +1,44 @@
+/**
+ * @file UaDI_expression.h
+ * @brief Internal compiler and interpreter of per-sample channel math.
+ *
+ * Expressions like "sqrt(i*i + q*q)" or "clamp(2*a - b, 0, 4095)" are
+ * compiled once into a stack bytecode. The interpreter runs every
+ * instruction over a block of frames before moving on to the next one, so
+ * the dispatch cost is paid once per block and each instruction is a plain
+ * loop over consecutive floats the compiler vectorizes.
+ *
+ * Grammar: numbers as in JSON, channel names, + - * / and unary minus with
+ * the usual precedence, parentheses and the functions abs(x), sqrt(x),
+ * min(a, b), max(a, b) and clamp(x, low, high). Constant subexpressions are
+ * folded and constant operands are encoded in the instruction.
+ */
+
+#ifndef UADI_EXPRESSION_H
+#define UADI_EXPRESSION_H
+
+#include "UaDI_template.h"
+
+#include <stddef.h>
+
+/* Most channels per frame, instructions per expression and stack depth */
+#define UADI_EXPRESSION_MAX_CHANNELS 16
+#define UADI_EXPRESSION_MAX_INSTRUCTIONS 128
+#define UADI_EXPRESSION_MAX_DEPTH 8
+
+struct uadi_expression;
+
+/* Compiles text over frames of channel_count interleaved samples named by
+ * channels. Returns UADI_ERROR on syntax errors, unknown names or an
+ * expression exceeding the limits, UADI_INTERNAL_ERROR when out of memory. */
+uadi_status uadi_expression_compile(char const* text, char const* const* channels,
+                                    size_t channel_count, struct uadi_expression** expression);
+
+void uadi_expression_destroy(struct uadi_expression* expression);
+
+/* Evaluates the expression for frame_count frames and writes one float per
+ * frame to out. out may alias frames. */
+void uadi_expression_evaluate(struct uadi_expression* expression, float* out,
+                              float const* frames, size_t frame_count);
+
+#endif // UADI_EXPRESSION_H
@@ -0,0 +1,82 @@
+/**
+ * @file UaDI_iota.c
+ * @brief Reference driver generating a sawtooth of floats.
+ *
+ * The iota device counts from 0 to 255, the inverse iota device from 255 to
+ * 0, continuing across chunks, as float32, float16 or bfloat16 samples.
+ */
+
+#include "UaDI_driver.h"
+#include "UaDI_kernels.h"
+
+#include <stdlib.h>
+
+struct iota{
+    unsigned int value; // next sample before the mask
+    unsigned int mask;  // 255 turns the iota into the inverse iota
+};
+
+static uadi_status open_iota(unsigned int mask, void** state)
+{
+    struct iota* iota = (struct iota*)calloc(1, sizeof(*iota));
+    if(!iota)
+        return UADI_INTERNAL_ERROR;
+    iota->mask = mask;
+    *state = iota;
+    return UADI_SUCCESS;
+}
+
+static uadi_status open_forward(struct uadi_device_options const* options, void** state)
+{
+    (void)options;
+    return open_iota(0u, state);
+}
+
+static uadi_status open_inverse(struct uadi_device_options const* options, void** state)
+{
+    (void)options;
+    return open_iota(255u, state);
+}
+
+static uadi_status fill_chunk(void* state, unsigned char* chunk, size_t chunk_size,
+                              int non_temporal, struct uadi_chunk_header* header)
+{
+    struct iota* iota = (struct iota*)state;
+    size_t count = header->sample_count;
+    (void)chunk_size;
+    /* The half precision kernels have no non-temporal variant. */
+    if(header->sample_format == UADI_FORMAT_FLOAT16)
+        uadi_kernels.fill_iota_f16((unsigned short*)chunk, count, iota->value, iota->mask);
+    else if(header->sample_format == UADI_FORMAT_BFLOAT16)
+        uadi_kernels.fill_iota_bf16((unsigned short*)chunk, count, iota->value, iota->mask);
+    else if(non_temporal)
+        uadi_kernels.fill_iota_stream((float*)chunk, count, iota->value, iota->mask);
+    else
+        uadi_kernels.fill_iota((float*)chunk, count, iota->value, iota->mask);
+    iota->value = (unsigned int)((iota->value + count) & 255u);
+    return UADI_SUCCESS;
+}
+
+struct uadi_driver const uadi_iota_driver = {
+    "123e4567-e89b-12d3-a456-426655440000",
+    "skunkforce e.V.",
+    "generates an iota",
+    0,
+    (1u << UADI_FORMAT_FLOAT16) | (1u << UADI_FORMAT_BFLOAT16),
+    open_forward,
+    fill_chunk,
+    NULL,
+    free,
+};
+
+struct uadi_driver const uadi_inverse_iota_driver = {
+    "e89b4567-123e-12d3-a456-426655440000",
+    "skunkforce e.V.",
+    "generates an inverse iota",
+    0,
+    (1u << UADI_FORMAT_FLOAT16) | (1u << UADI_FORMAT_BFLOAT16),
+    open_inverse,
+    fill_chunk,
+    NULL,
+    free,
+};
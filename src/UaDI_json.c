@@ -0,0 +1,369 @@
+/**
+ * @file UaDI_json.c
+ * @brief Recursive descent JSON parser.
+ */
+
+#include "UaDI_json.h"
+
+#include <locale.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UADI_JSON_MAX_DEPTH 64
+
+struct parser{
+    char const* at;
+    int depth;
+};
+
+static void skip_space(struct parser* parser)
+{
+    while(*parser->at == ' ' || *parser->at == '\t' || *parser->at == '\n' || *parser->at == '\r')
+        ++parser->at;
+}
+
+static int hex_digit(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int parse_hex4(char const* at, unsigned long* value)
+{
+    int i;
+    *value = 0;
+    for(i = 0; i < 4; ++i){
+        int digit = hex_digit(at[i]);
+        if(digit < 0)
+            return 0;
+        *value = (*value << 4) | (unsigned long)digit;
+    }
+    return 1;
+}
+
+static char* encode_utf8(char* out, unsigned long code)
+{
+    if(code < 0x80){
+        *out++ = (char)code;
+    } else if(code < 0x800){
+        *out++ = (char)(0xC0 | (code >> 6));
+        *out++ = (char)(0x80 | (code & 0x3F));
+    } else if(code < 0x10000){
+        *out++ = (char)(0xE0 | (code >> 12));
+        *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (code & 0x3F));
+    } else {
+        *out++ = (char)(0xF0 | (code >> 18));
+        *out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+        *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+        *out++ = (char)(0x80 | (code & 0x3F));
+    }
+    return out;
+}
+
+/* Parses a string literal. The decoded string is never longer than the
+ * literal, which sizes the allocation. */
+static char* parse_string(struct parser* parser)
+{
+    char const* end = parser->at + 1;
+    char* string;
+    char* out;
+    unsigned long code;
+    unsigned long low;
+
+    while(*end && *end != '"'){
+        if(*end == '\\' && end[1])
+            ++end;
+        ++end;
+    }
+    if(*end != '"')
+        return NULL;
+    string = (char*)malloc((size_t)(end - parser->at));
+    if(!string)
+        return NULL;
+
+    out = string;
+    for(++parser->at; *parser->at != '"'; ++parser->at){
+        if((unsigned char)*parser->at < 0x20)
+            goto fail;
+        if(*parser->at != '\\'){
+            *out++ = *parser->at;
+            continue;
+        }
+        switch(*++parser->at){
+        case '"': *out++ = '"'; break;
+        case '\\': *out++ = '\\'; break;
+        case '/': *out++ = '/'; break;
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u':
+            if(!parse_hex4(parser->at + 1, &code))
+                goto fail;
+            parser->at += 4;
+            if(code >= 0xD800 && code < 0xDC00){
+                if(parser->at[1] != '\\' || parser->at[2] != 'u'
+                   || !parse_hex4(parser->at + 3, &low) || low < 0xDC00 || low > 0xDFFF)
+                    goto fail;
+                parser->at += 6;
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+            out = encode_utf8(out, code);
+            break;
+        default:
+            goto fail;
+        }
+    }
+    ++parser->at;
+    *out = '\0';
+    return string;
+
+fail:
+    free(string);
+    return NULL;
+}
+
+static int is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* Length of the number at text following the JSON grammar, 0 if none. */
+static size_t number_length(char const* text)
+{
+    char const* at = text;
+
+    if(*at == '-')
+        ++at;
+    if(*at == '0')
+        ++at;
+    else if(is_digit(*at))
+        while(is_digit(*at))
+            ++at;
+    else
+        return 0;
+    if(*at == '.'){
+        if(!is_digit(*++at))
+            return 0;
+        while(is_digit(*at))
+            ++at;
+    }
+    if(*at == 'e' || *at == 'E'){
+        ++at;
+        if(*at == '+' || *at == '-')
+            ++at;
+        if(!is_digit(*at))
+            return 0;
+        while(is_digit(*at))
+            ++at;
+    }
+    return (size_t)(at - text);
+}
+
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void create_c_locale(void)
+{
+    c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+char const* uadi_json_scan_number(char const* text, double* number)
+{
+    size_t length = number_length(text);
+    locale_t previous;
+    char* end;
+
+    /* strtod follows the locale of the thread, which the host application
+     * may have set to one with a decimal comma. The number is converted in
+     * the "C" locale on this thread only. */
+    pthread_once(&c_locale_once, create_c_locale);
+    if(!length || c_locale == (locale_t)0)
+        return NULL;
+    previous = uselocale(c_locale);
+    *number = strtod(text, &end);
+    uselocale(previous);
+    return end == text + length ? end : NULL;
+}
+
+static int parse_number(struct parser* parser, double* number)
+{
+    char const* end = uadi_json_scan_number(parser->at, number);
+    if(!end)
+        return 0;
+    parser->at = end;
+    return 1;
+}
+
+static int match(struct parser* parser, char const* literal)
+{
+    size_t length = strlen(literal);
+    if(strncmp(parser->at, literal, length) != 0)
+        return 0;
+    parser->at += length;
+    return 1;
+}
+
+static struct uadi_json* parse_value(struct parser* parser);
+
+/* Parses the elements of an array or the members of an object, the opening
+ * bracket has already been consumed. */
+static int parse_children(struct parser* parser, struct uadi_json* parent, char close)
+{
+    struct uadi_json** link = &parent->child;
+    struct uadi_json* child;
+    char* key = NULL;
+
+    skip_space(parser);
+    if(*parser->at == close){
+        ++parser->at;
+        return 1;
+    }
+    for(;;){
+        if(parent->type == UADI_JSON_OBJECT){
+            skip_space(parser);
+            if(*parser->at != '"' || !(key = parse_string(parser)))
+                return 0;
+            skip_space(parser);
+            if(*parser->at != ':'){
+                free(key);
+                return 0;
+            }
+            ++parser->at;
+        }
+        child = parse_value(parser);
+        if(!child){
+            free(key);
+            return 0;
+        }
+        child->key = key;
+        key = NULL;
+        *link = child;
+        link = &child->next;
+
+        skip_space(parser);
+        if(*parser->at == close){
+            ++parser->at;
+            return 1;
+        }
+        if(*parser->at != ',')
+            return 0;
+        ++parser->at;
+    }
+}
+
+static struct uadi_json* parse_value(struct parser* parser)
+{
+    struct uadi_json* json;
+    int ok = 1;
+
+    if(++parser->depth > UADI_JSON_MAX_DEPTH)
+        return NULL;
+    json = (struct uadi_json*)calloc(1, sizeof(*json));
+    if(!json)
+        return NULL;
+
+    skip_space(parser);
+    switch(*parser->at){
+    case '{':
+        ++parser->at;
+        json->type = UADI_JSON_OBJECT;
+        ok = parse_children(parser, json, '}');
+        break;
+    case '[':
+        ++parser->at;
+        json->type = UADI_JSON_ARRAY;
+        ok = parse_children(parser, json, ']');
+        break;
+    case '"':
+        json->type = UADI_JSON_STRING;
+        ok = (json->string = parse_string(parser)) != NULL;
+        break;
+    case 't':
+        json->type = UADI_JSON_TRUE;
+        ok = match(parser, "true");
+        break;
+    case 'f':
+        json->type = UADI_JSON_FALSE;
+        ok = match(parser, "false");
+        break;
+    case 'n':
+        json->type = UADI_JSON_NULL;
+        ok = match(parser, "null");
+        break;
+    default:
+        json->type = UADI_JSON_NUMBER;
+        ok = parse_number(parser, &json->number);
+        break;
+    }
+    --parser->depth;
+    if(!ok){
+        uadi_json_free(json);
+        return NULL;
+    }
+    return json;
+}
+
+struct uadi_json* uadi_json_parse(char const* text)
+{
+    struct parser parser;
+    struct uadi_json* json;
+
+    if(!text)
+        return NULL;
+    parser.at = text;
+    parser.depth = 0;
+    json = parse_value(&parser);
+    if(!json)
+        return NULL;
+    skip_space(&parser);
+    if(*parser.at != '\0'){
+        uadi_json_free(json);
+        return NULL;
+    }
+    return json;
+}
+
+void uadi_json_free(struct uadi_json* json)
+{
+    struct uadi_json* next;
+    while(json){
+        next = json->next;
+        uadi_json_free(json->child);
+        free(json->key);
+        free(json->string);
+        free(json);
+        json = next;
+    }
+}
+
+struct uadi_json const* uadi_json_member(struct uadi_json const* json, char const* key)
+{
+    struct uadi_json const* member;
+    if(!json || json->type != UADI_JSON_OBJECT)
+        return NULL;
+    for(member = json->child; member; member = member->next)
+        if(strcmp(member->key, key) == 0)
+            return member;
+    return NULL;
+}
+
+char const* uadi_json_string(struct uadi_json const* json, char const* key)
+{
+    struct uadi_json const* member = uadi_json_member(json, key);
+    return member && member->type == UADI_JSON_STRING ? member->string : NULL;
+}
+
+double uadi_json_number(struct uadi_json const* json, char const* key, double fallback)
+{
+    struct uadi_json const* member = uadi_json_member(json, key);
+    return member && member->type == UADI_JSON_NUMBER ? member->number : fallback;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file UaDI_json.h
+ * @brief Internal parser for the JSON commands of uadi_send_json.
+ *
+ * Commands are small and rare, so the parser builds a plain tree of nodes
+ * with one allocation per node and favours simplicity over speed.
+ */
+
+#ifndef UADI_JSON_H
+#define UADI_JSON_H
+
+#include <stddef.h>
+
+enum uadi_json_type{
+    UADI_JSON_NULL,
+    UADI_JSON_FALSE,
+    UADI_JSON_TRUE,
+    UADI_JSON_NUMBER,
+    UADI_JSON_STRING,
+    UADI_JSON_ARRAY,
+    UADI_JSON_OBJECT
+};
+
+struct uadi_json{
+    enum uadi_json_type type;
+    char* key;               /* member name, NULL outside of objects */
+    char* string;            /* UTF-8 value of strings */
+    double number;
+    struct uadi_json* child; /* first element or member */
+    struct uadi_json* next;  /* next sibling */
+};
+
+/* Parses a complete JSON text. Returns NULL on syntax errors, nesting deeper
+ * than 64 levels or when out of memory. */
+struct uadi_json* uadi_json_parse(char const* text);
+void uadi_json_free(struct uadi_json* json);
+
+/* Converts the JSON number at the start of text in the "C" locale, so '.'
+ * is the decimal point whatever locale the process or thread uses. Returns
+ * the end of the number, NULL if text doesn't start with one. */
+char const* uadi_json_scan_number(char const* text, double* number);
+
+/* Member of an object by name, NULL if json is no object or has no such
+ * member. */
+struct uadi_json const* uadi_json_member(struct uadi_json const* json, char const* key);
+
+/* Value of a string member, NULL if missing or not a string. */
+char const* uadi_json_string(struct uadi_json const* json, char const* key);
+
+/* Value of a number member, fallback if missing or not a number. */
+double uadi_json_number(struct uadi_json const* json, char const* key, double fallback);
+
+#endif // UADI_JSON_H
@@ -0,0 +1,849 @@
+/**
+ * @file UaDI_kernels.c
+ * @brief Scalar and SIMD variants of the sample kernels and their runtime selection.
+ */
+
+#include "UaDI_kernels.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UADI_X86_DISPATCH 1
+#include <cpuid.h>
+#include <immintrin.h>
+#if defined(__clang__) || __GNUC__ >= 10
+#define UADI_AVX512_BF16 1
+#endif
+/* The three streams run on 64 bit words, _mm_crc32_u64 is x86-64 only. */
+#ifdef __x86_64__
+#define UADI_CRC32C_SSE42 1
+#endif
+#endif
+
+static void fill_iota_scalar(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        samples[i] = (float)(((value + (unsigned int)i) & 255u) ^ mask);
+}
+
+static unsigned short float_to_f16(float value)
+{
+    uint32_t bits;
+    uint32_t sign;
+    uint32_t mantissa;
+    uint32_t half;
+    uint32_t remainder;
+    uint32_t halfway;
+    int exponent;
+    int shift;
+
+    memcpy(&bits, &value, sizeof(bits));
+    sign = (bits >> 16) & 0x8000u;
+    mantissa = bits & 0x7fffffu;
+    exponent = (int)((bits >> 23) & 0xffu);
+    if(exponent == 0xff)
+        return (unsigned short)(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+    exponent -= 127 - 15;
+    if(exponent >= 31)
+        return (unsigned short)(sign | 0x7c00u);
+    if(exponent <= 0){
+        /* Subnormal, in units of 2^-24. */
+        if(exponent < -10)
+            return (unsigned short)sign;
+        mantissa |= 0x800000u;
+        shift = 14 - exponent;
+    } else {
+        mantissa |= (uint32_t)exponent << 23;
+        shift = 13;
+    }
+    half = mantissa >> shift;
+    remainder = mantissa & ((1u << shift) - 1u);
+    halfway = 1u << (shift - 1);
+    /* A carry out of the mantissa correctly increments the exponent. */
+    if(remainder > halfway || (remainder == halfway && (half & 1u)))
+        ++half;
+    return (unsigned short)(sign | half);
+}
+
+static float f16_to_float(unsigned short half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    float value;
+
+    if(exponent == 0x1f){
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if(exponent){
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else {
+        value = (float)mantissa * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static unsigned short float_to_bf16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if((bits & 0x7fffffffu) > 0x7f800000u)
+        return (unsigned short)((bits >> 16) | 0x40u);
+    return (unsigned short)((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+}
+
+static void fill_iota_f16_scalar(unsigned short* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        samples[i] = float_to_f16((float)(((value + (unsigned int)i) & 255u) ^ mask));
+}
+
+static void fill_iota_bf16_scalar(unsigned short* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        samples[i] = float_to_bf16((float)(((value + (unsigned int)i) & 255u) ^ mask));
+}
+
+static void widen_f16_scalar(float* out, unsigned short const* samples, size_t count)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        out[i] = f16_to_float(samples[i]);
+}
+
+static void widen_bf16_scalar(float* out, unsigned short const* samples, size_t count)
+{
+    uint32_t bits;
+    size_t i;
+    for(i = 0; i < count; ++i){
+        bits = (uint32_t)samples[i] << 16;
+        memcpy(&out[i], &bits, sizeof(bits));
+    }
+}
+
+static void scale_scalar(float* samples, size_t count, float gain, float offset)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        samples[i] = gain * samples[i] + offset;
+}
+
+static void multiply_accumulate_scalar(float* out, float const* in, size_t count, float factor)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        out[i] += factor * in[i];
+}
+
+/* Folds count samples into a summary that already holds at least one. */
+static void summarize_scalar(float const* samples, size_t count, struct uadi_summary* summary)
+{
+    size_t i;
+    for(i = 0; i < count; ++i){
+        summary->minimum = samples[i] < summary->minimum ? samples[i] : summary->minimum;
+        summary->maximum = samples[i] > summary->maximum ? samples[i] : summary->maximum;
+        summary->sum += samples[i];
+        summary->sum_squares += samples[i] * samples[i];
+    }
+}
+
+/* CRC32C, the Castagnoli polynomial in reflected form. The software variant
+ * uses slicing by 8 over tables built once by select_kernels. */
+#define CRC32C_POLY 0x82f63b78u
+
+static uint32_t crc32c_table[8][256];
+
+static void build_crc32c_table(void)
+{
+    uint32_t crc;
+    unsigned int n, k;
+    for(n = 0; n < 256; ++n){
+        crc = n;
+        for(k = 0; k < 8; ++k)
+            crc = crc & 1u ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[0][n] = crc;
+    }
+    for(n = 0; n < 256; ++n){
+        crc = crc32c_table[0][n];
+        for(k = 1; k < 8; ++k){
+            crc = crc32c_table[0][crc & 0xffu] ^ (crc >> 8);
+            crc32c_table[k][n] = crc;
+        }
+    }
+}
+
+static uint32_t crc32c_scalar(uint32_t crc, void const* data, size_t size)
+{
+    unsigned char const* next = (unsigned char const*)data;
+    uint64_t word;
+
+    crc = ~crc;
+    while(size && ((uintptr_t)next & 7u)){
+        crc = crc32c_table[0][(crc ^ *next++) & 0xffu] ^ (crc >> 8);
+        --size;
+    }
+    while(size >= 8){
+        /* Little endian, like every target the library is built for. */
+        memcpy(&word, next, sizeof(word));
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xffu] ^ crc32c_table[6][(word >> 8) & 0xffu]
+            ^ crc32c_table[5][(word >> 16) & 0xffu] ^ crc32c_table[4][(word >> 24) & 0xffu]
+            ^ crc32c_table[3][(word >> 32) & 0xffu] ^ crc32c_table[2][(word >> 40) & 0xffu]
+            ^ crc32c_table[1][(word >> 48) & 0xffu] ^ crc32c_table[0][word >> 56];
+        next += 8;
+        size -= 8;
+    }
+    while(size--)
+        crc = crc32c_table[0][(crc ^ *next++) & 0xffu] ^ (crc >> 8);
+    return ~crc;
+}
+
+#ifdef UADI_X86_DISPATCH
+
+#ifdef UADI_CRC32C_SSE42
+/* The crc32 instruction has a latency of three cycles and a throughput of
+ * one, so the SSE4.2 variant runs three independent streams over adjacent
+ * blocks and folds them together. Folding shifts a CRC over the length of a
+ * block of zeros, a linear operator applied through four byte tables. Long
+ * blocks cover the bulk of a chunk, short blocks most of the rest. */
+#define CRC32C_LONG 8192
+#define CRC32C_SHORT 256
+
+static uint32_t crc32c_long[4][256];
+static uint32_t crc32c_short[4][256];
+
+static uint32_t gf2_matrix_times(uint32_t const* matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    for(; vector; vector >>= 1, ++matrix)
+        if(vector & 1u)
+            sum ^= *matrix;
+    return sum;
+}
+
+static void gf2_matrix_square(uint32_t* square, uint32_t const* matrix)
+{
+    int n;
+    for(n = 0; n < 32; ++n)
+        square[n] = gf2_matrix_times(matrix, matrix[n]);
+}
+
+/* Builds the operator that appends size zero bytes to a CRC register, size
+ * being a power of two. */
+static void crc32c_zeros_operator(uint32_t* even, size_t size)
+{
+    uint32_t odd[32];
+    uint32_t row = 1;
+    int n;
+
+    /* One zero bit, squared to two and four zero bits. */
+    odd[0] = CRC32C_POLY;
+    for(n = 1; n < 32; ++n){
+        odd[n] = row;
+        row <<= 1;
+    }
+    gf2_matrix_square(even, odd);
+    gf2_matrix_square(odd, even);
+    /* Every further square doubles the zeros, starting at one byte. */
+    for(;;){
+        gf2_matrix_square(even, odd);
+        size >>= 1;
+        if(!size)
+            return;
+        gf2_matrix_square(odd, even);
+        size >>= 1;
+        if(!size)
+            break;
+    }
+    memcpy(even, odd, sizeof(odd));
+}
+
+static void build_crc32c_zeros(uint32_t zeros[4][256], size_t size)
+{
+    uint32_t op[32];
+    uint32_t n;
+    crc32c_zeros_operator(op, size);
+    for(n = 0; n < 256; ++n){
+        zeros[0][n] = gf2_matrix_times(op, n);
+        zeros[1][n] = gf2_matrix_times(op, n << 8);
+        zeros[2][n] = gf2_matrix_times(op, n << 16);
+        zeros[3][n] = gf2_matrix_times(op, n << 24);
+    }
+}
+
+static uint32_t crc32c_shift(uint32_t zeros[4][256], uint32_t crc)
+{
+    return zeros[0][crc & 0xffu] ^ zeros[1][(crc >> 8) & 0xffu]
+         ^ zeros[2][(crc >> 16) & 0xffu] ^ zeros[3][crc >> 24];
+}
+
+__attribute__((target("sse4.2")))
+static uint64_t crc32c_blocks(uint64_t crc, unsigned char const** position, size_t* size,
+                              size_t block, uint32_t zeros[4][256])
+{
+    unsigned char const* next = *position;
+    unsigned char const* end;
+    uint64_t crc1, crc2, word0, word1, word2;
+
+    for(; *size >= 3 * block; *size -= 3 * block){
+        crc1 = 0;
+        crc2 = 0;
+        for(end = next + block; next < end; next += 8){
+            memcpy(&word0, next, sizeof(word0));
+            memcpy(&word1, next + block, sizeof(word1));
+            memcpy(&word2, next + 2 * block, sizeof(word2));
+            crc = _mm_crc32_u64(crc, word0);
+            crc1 = _mm_crc32_u64(crc1, word1);
+            crc2 = _mm_crc32_u64(crc2, word2);
+        }
+        crc = crc32c_shift(zeros, (uint32_t)crc) ^ crc1;
+        crc = crc32c_shift(zeros, (uint32_t)crc) ^ crc2;
+        next += 2 * block;
+    }
+    *position = next;
+    return crc;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, void const* data, size_t size)
+{
+    unsigned char const* next = (unsigned char const*)data;
+    uint64_t crc0 = ~crc;
+    uint64_t word;
+
+    while(size && ((uintptr_t)next & 7u)){
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *next++);
+        --size;
+    }
+    crc0 = crc32c_blocks(crc0, &next, &size, CRC32C_LONG, crc32c_long);
+    crc0 = crc32c_blocks(crc0, &next, &size, CRC32C_SHORT, crc32c_short);
+    while(size >= 8){
+        memcpy(&word, next, sizeof(word));
+        crc0 = _mm_crc32_u64(crc0, word);
+        next += 8;
+        size -= 8;
+    }
+    while(size--)
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *next++);
+    return ~(uint32_t)crc0;
+}
+#endif // UADI_CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+static void fill_iota_sse42(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m128i const byte = _mm_set1_epi32(255);
+    __m128i const xor_mask = _mm_set1_epi32((int)mask);
+    __m128i const step = _mm_set1_epi32(4);
+    __m128i index = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128i v = _mm_xor_si128(_mm_and_si128(index, byte), xor_mask);
+        _mm_storeu_ps(samples + i, _mm_cvtepi32_ps(v));
+        index = _mm_add_epi32(index, step);
+    }
+    fill_iota_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+
+__attribute__((target("sse4.2")))
+static void scale_sse42(float* samples, size_t count, float gain, float offset)
+{
+    __m128 const g = _mm_set1_ps(gain);
+    __m128 const o = _mm_set1_ps(offset);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_ps(samples + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(samples + i), g), o));
+    scale_scalar(samples + i, count - i, gain, offset);
+}
+
+__attribute__((target("sse4.2")))
+static void multiply_accumulate_sse42(float* out, float const* in, size_t count, float factor)
+{
+    __m128 const f = _mm_set1_ps(factor);
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i),
+                                          _mm_mul_ps(_mm_loadu_ps(in + i), f)));
+    multiply_accumulate_scalar(out + i, in + i, count - i, factor);
+}
+
+/* The vector variants keep one running minimum, maximum and sum per lane and
+ * fold the lanes into the summary at the end. */
+static void fold_lanes(float const* minimum, float const* maximum, float const* sum,
+                       float const* sum_squares, size_t lanes, struct uadi_summary* summary)
+{
+    size_t i;
+    for(i = 0; i < lanes; ++i){
+        summary->minimum = minimum[i] < summary->minimum ? minimum[i] : summary->minimum;
+        summary->maximum = maximum[i] > summary->maximum ? maximum[i] : summary->maximum;
+        summary->sum += sum[i];
+        summary->sum_squares += sum_squares[i];
+    }
+}
+
+__attribute__((target("sse4.2")))
+static void summarize_sse42(float const* samples, size_t count, struct uadi_summary* summary)
+{
+    float lanes[4][4];
+    __m128 minimum = _mm_set1_ps(summary->minimum);
+    __m128 maximum = _mm_set1_ps(summary->maximum);
+    __m128 sum = _mm_setzero_ps();
+    __m128 sum_squares = _mm_setzero_ps();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128 v = _mm_loadu_ps(samples + i);
+        minimum = _mm_min_ps(minimum, v);
+        maximum = _mm_max_ps(maximum, v);
+        sum = _mm_add_ps(sum, v);
+        sum_squares = _mm_add_ps(sum_squares, _mm_mul_ps(v, v));
+    }
+    _mm_storeu_ps(lanes[0], minimum);
+    _mm_storeu_ps(lanes[1], maximum);
+    _mm_storeu_ps(lanes[2], sum);
+    _mm_storeu_ps(lanes[3], sum_squares);
+    fold_lanes(lanes[0], lanes[1], lanes[2], lanes[3], 4, summary);
+    summarize_scalar(samples + i, count - i, summary);
+}
+
+__attribute__((target("avx2")))
+static void fill_iota_avx2(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m256i const byte = _mm256_set1_epi32(255);
+    __m256i const xor_mask = _mm256_set1_epi32((int)mask);
+    __m256i const step = _mm256_set1_epi32(8);
+    __m256i index = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                     _mm256_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256i v = _mm256_xor_si256(_mm256_and_si256(index, byte), xor_mask);
+        _mm256_storeu_ps(samples + i, _mm256_cvtepi32_ps(v));
+        index = _mm256_add_epi32(index, step);
+    }
+    fill_iota_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+
+__attribute__((target("avx2")))
+static void scale_avx2(float* samples, size_t count, float gain, float offset)
+{
+    __m256 const g = _mm256_set1_ps(gain);
+    __m256 const o = _mm256_set1_ps(offset);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(samples + i), g), o));
+    scale_scalar(samples + i, count - i, gain, offset);
+}
+
+__attribute__((target("avx2")))
+static void multiply_accumulate_avx2(float* out, float const* in, size_t count, float factor)
+{
+    __m256 const f = _mm256_set1_ps(factor);
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i),
+                                                _mm256_mul_ps(_mm256_loadu_ps(in + i), f)));
+    multiply_accumulate_scalar(out + i, in + i, count - i, factor);
+}
+
+__attribute__((target("avx2")))
+static void summarize_avx2(float const* samples, size_t count, struct uadi_summary* summary)
+{
+    float lanes[4][8];
+    __m256 minimum = _mm256_set1_ps(summary->minimum);
+    __m256 maximum = _mm256_set1_ps(summary->maximum);
+    __m256 sum = _mm256_setzero_ps();
+    __m256 sum_squares = _mm256_setzero_ps();
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256 v = _mm256_loadu_ps(samples + i);
+        minimum = _mm256_min_ps(minimum, v);
+        maximum = _mm256_max_ps(maximum, v);
+        sum = _mm256_add_ps(sum, v);
+        sum_squares = _mm256_add_ps(sum_squares, _mm256_mul_ps(v, v));
+    }
+    _mm256_storeu_ps(lanes[0], minimum);
+    _mm256_storeu_ps(lanes[1], maximum);
+    _mm256_storeu_ps(lanes[2], sum);
+    _mm256_storeu_ps(lanes[3], sum_squares);
+    fold_lanes(lanes[0], lanes[1], lanes[2], lanes[3], 8, summary);
+    summarize_scalar(samples + i, count - i, summary);
+}
+
+__attribute__((target("avx512f")))
+static void fill_iota_avx512(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m512i const byte = _mm512_set1_epi32(255);
+    __m512i const xor_mask = _mm512_set1_epi32((int)mask);
+    __m512i const step = _mm512_set1_epi32(16);
+    __m512i index = _mm512_add_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16){
+        __m512i v = _mm512_xor_si512(_mm512_and_si512(index, byte), xor_mask);
+        _mm512_storeu_ps(samples + i, _mm512_cvtepi32_ps(v));
+        index = _mm512_add_epi32(index, step);
+    }
+    fill_iota_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+
+__attribute__((target("avx512f")))
+static void scale_avx512(float* samples, size_t count, float gain, float offset)
+{
+    __m512 const g = _mm512_set1_ps(gain);
+    __m512 const o = _mm512_set1_ps(offset);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16)
+        _mm512_storeu_ps(samples + i, _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(samples + i), g), o));
+    scale_scalar(samples + i, count - i, gain, offset);
+}
+
+__attribute__((target("avx512f")))
+static void multiply_accumulate_avx512(float* out, float const* in, size_t count, float factor)
+{
+    __m512 const f = _mm512_set1_ps(factor);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16)
+        _mm512_storeu_ps(out + i, _mm512_add_ps(_mm512_loadu_ps(out + i),
+                                                _mm512_mul_ps(_mm512_loadu_ps(in + i), f)));
+    multiply_accumulate_scalar(out + i, in + i, count - i, factor);
+}
+
+__attribute__((target("avx512f")))
+static void summarize_avx512(float const* samples, size_t count, struct uadi_summary* summary)
+{
+    float lanes[4][16];
+    __m512 minimum = _mm512_set1_ps(summary->minimum);
+    __m512 maximum = _mm512_set1_ps(summary->maximum);
+    __m512 sum = _mm512_setzero_ps();
+    __m512 sum_squares = _mm512_setzero_ps();
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16){
+        __m512 v = _mm512_loadu_ps(samples + i);
+        minimum = _mm512_min_ps(minimum, v);
+        maximum = _mm512_max_ps(maximum, v);
+        sum = _mm512_add_ps(sum, v);
+        sum_squares = _mm512_add_ps(sum_squares, _mm512_mul_ps(v, v));
+    }
+    _mm512_storeu_ps(lanes[0], minimum);
+    _mm512_storeu_ps(lanes[1], maximum);
+    _mm512_storeu_ps(lanes[2], sum);
+    _mm512_storeu_ps(lanes[3], sum_squares);
+    fold_lanes(lanes[0], lanes[1], lanes[2], lanes[3], 16, summary);
+    summarize_scalar(samples + i, count - i, summary);
+}
+
+/* Number of samples to fill with regular stores until samples is aligned to
+ * alignment bytes. Samples that are not even float aligned are never aligned,
+ * in that case everything is filled with regular stores. */
+static size_t unaligned_head(float const* samples, size_t count, size_t alignment)
+{
+    uintptr_t misalignment = (uintptr_t)samples & (alignment - 1);
+    size_t head;
+    if(misalignment % sizeof(float))
+        return count;
+    head = misalignment ? (alignment - misalignment) / sizeof(float) : 0;
+    return head < count ? head : count;
+}
+
+__attribute__((target("sse4.2")))
+static void fill_iota_stream_sse42(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m128i const byte = _mm_set1_epi32(255);
+    __m128i const xor_mask = _mm_set1_epi32((int)mask);
+    __m128i const step = _mm_set1_epi32(4);
+    __m128i index;
+    size_t i = unaligned_head(samples, count, 16);
+    fill_iota_scalar(samples, i, value, mask);
+    index = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)(value + i)));
+    for(; i + 4 <= count; i += 4){
+        __m128i v = _mm_xor_si128(_mm_and_si128(index, byte), xor_mask);
+        _mm_stream_ps(samples + i, _mm_cvtepi32_ps(v));
+        index = _mm_add_epi32(index, step);
+    }
+    fill_iota_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void fill_iota_stream_avx2(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m256i const byte = _mm256_set1_epi32(255);
+    __m256i const xor_mask = _mm256_set1_epi32((int)mask);
+    __m256i const step = _mm256_set1_epi32(8);
+    __m256i index;
+    size_t i = unaligned_head(samples, count, 32);
+    fill_iota_scalar(samples, i, value, mask);
+    index = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                             _mm256_set1_epi32((int)(value + i)));
+    for(; i + 8 <= count; i += 8){
+        __m256i v = _mm256_xor_si256(_mm256_and_si256(index, byte), xor_mask);
+        _mm256_stream_ps(samples + i, _mm256_cvtepi32_ps(v));
+        index = _mm256_add_epi32(index, step);
+    }
+    fill_iota_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+    _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+static void fill_iota_stream_avx512(float* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m512i const byte = _mm512_set1_epi32(255);
+    __m512i const xor_mask = _mm512_set1_epi32((int)mask);
+    __m512i const step = _mm512_set1_epi32(16);
+    __m512i index;
+    size_t i = unaligned_head(samples, count, 64);
+    fill_iota_scalar(samples, i, value, mask);
+    index = _mm512_add_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32((int)(value + i)));
+    for(; i + 16 <= count; i += 16){
+        __m512i v = _mm512_xor_si512(_mm512_and_si512(index, byte), xor_mask);
+        _mm512_stream_ps(samples + i, _mm512_cvtepi32_ps(v));
+        index = _mm512_add_epi32(index, step);
+    }
+    fill_iota_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+    _mm_sfence();
+}
+
+__attribute__((target("avx2,f16c")))
+static void fill_iota_f16_avx2(unsigned short* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m256i const byte = _mm256_set1_epi32(255);
+    __m256i const xor_mask = _mm256_set1_epi32((int)mask);
+    __m256i const step = _mm256_set1_epi32(8);
+    __m256i index = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                     _mm256_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256i v = _mm256_xor_si256(_mm256_and_si256(index, byte), xor_mask);
+        _mm_storeu_si128((__m128i*)(samples + i),
+                         _mm256_cvtps_ph(_mm256_cvtepi32_ps(v), _MM_FROUND_TO_NEAREST_INT));
+        index = _mm256_add_epi32(index, step);
+    }
+    fill_iota_f16_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+
+/* AVX2 has no bfloat16 conversion, the rounding to nearest even is done on
+ * the bits. Iota samples are never NaN. */
+__attribute__((target("avx2")))
+static void fill_iota_bf16_avx2(unsigned short* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m256i const byte = _mm256_set1_epi32(255);
+    __m256i const xor_mask = _mm256_set1_epi32((int)mask);
+    __m256i const step = _mm256_set1_epi32(8);
+    __m256i const one = _mm256_set1_epi32(1);
+    __m256i const bias = _mm256_set1_epi32(0x7fff);
+    __m256i index = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                     _mm256_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256i v = _mm256_xor_si256(_mm256_and_si256(index, byte), xor_mask);
+        __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(v));
+        __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+        __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(bits, _mm256_add_epi32(lsb, bias)), 16);
+        /* Packing works per 128 bit lane, the permute joins both halves. */
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(rounded, rounded), 0x08);
+        _mm_storeu_si128((__m128i*)(samples + i), _mm256_castsi256_si128(packed));
+        index = _mm256_add_epi32(index, step);
+    }
+    fill_iota_bf16_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+
+__attribute__((target("avx2,f16c")))
+static void widen_f16_avx2(float* out, unsigned short const* samples, size_t count)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((__m128i const*)(samples + i))));
+    widen_f16_scalar(out + i, samples + i, count - i);
+}
+
+__attribute__((target("avx512f")))
+static void fill_iota_f16_avx512(unsigned short* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m512i const byte = _mm512_set1_epi32(255);
+    __m512i const xor_mask = _mm512_set1_epi32((int)mask);
+    __m512i const step = _mm512_set1_epi32(16);
+    __m512i index = _mm512_add_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16){
+        __m512i v = _mm512_xor_si512(_mm512_and_si512(index, byte), xor_mask);
+        _mm256_storeu_si256((__m256i*)(samples + i),
+                            _mm512_cvtps_ph(_mm512_cvtepi32_ps(v), _MM_FROUND_TO_NEAREST_INT));
+        index = _mm512_add_epi32(index, step);
+    }
+    fill_iota_f16_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+
+#ifdef UADI_AVX512_BF16
+__attribute__((target("avx512f,avx512bf16")))
+static void fill_iota_bf16_avx512(unsigned short* samples, size_t count, unsigned int value, unsigned int mask)
+{
+    __m512i const byte = _mm512_set1_epi32(255);
+    __m512i const xor_mask = _mm512_set1_epi32((int)mask);
+    __m512i const step = _mm512_set1_epi32(16);
+    __m512i index = _mm512_add_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32((int)value));
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16){
+        __m512i v = _mm512_xor_si512(_mm512_and_si512(index, byte), xor_mask);
+        _mm256_storeu_si256((__m256i*)(samples + i),
+                            (__m256i)_mm512_cvtneps_pbh(_mm512_cvtepi32_ps(v)));
+        index = _mm512_add_epi32(index, step);
+    }
+    fill_iota_bf16_scalar(samples + i, count - i, value + (unsigned int)i, mask);
+}
+#endif
+
+/* F16C (CPUID.1:ECX[29]) and AVX512-BF16 (CPUID.(7,1):EAX[5]) are read from
+ * CPUID directly, not every compiler knows them in __builtin_cpu_supports. */
+static int has_f16c(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 29));
+}
+
+static int has_avx512_bf16(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx) && (eax & (1u << 5));
+}
+
+static enum uadi_isa detect_isa(void)
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return UADI_ISA_AVX512;
+    if(__builtin_cpu_supports("avx2"))
+        return UADI_ISA_AVX2;
+    if(__builtin_cpu_supports("sse4.2"))
+        return UADI_ISA_SSE42;
+    return UADI_ISA_SCALAR;
+}
+
+#else
+
+static enum uadi_isa detect_isa(void)
+{
+    return UADI_ISA_SCALAR;
+}
+
+#endif // UADI_X86_DISPATCH
+
+struct uadi_kernel_table uadi_kernels = {
+    UADI_ISA_SCALAR,
+    fill_iota_scalar,
+    fill_iota_scalar,
+    fill_iota_f16_scalar,
+    fill_iota_bf16_scalar,
+    widen_f16_scalar,
+    widen_bf16_scalar,
+    crc32c_scalar,
+    scale_scalar,
+    multiply_accumulate_scalar,
+    summarize_scalar,
+};
+
+static char const* const isa_names[] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+char const* uadi_isa_name(enum uadi_isa isa)
+{
+    return isa_names[isa];
+}
+
+static enum uadi_isa requested_isa(enum uadi_isa detected)
+{
+    char const* name = getenv("UADI_ISA");
+    int isa;
+    if(!name)
+        return detected;
+    for(isa = UADI_ISA_SCALAR; isa <= UADI_ISA_AVX512; ++isa)
+        if(strcmp(name, isa_names[isa]) == 0)
+            return (enum uadi_isa)isa < detected ? (enum uadi_isa)isa : detected;
+    return detected;
+}
+
+static void select_kernels(void)
+{
+    struct uadi_kernel_table table;
+    table.isa = requested_isa(detect_isa());
+    table.fill_iota = fill_iota_scalar;
+    table.fill_iota_stream = fill_iota_scalar;
+    table.fill_iota_f16 = fill_iota_f16_scalar;
+    table.fill_iota_bf16 = fill_iota_bf16_scalar;
+    table.widen_f16 = widen_f16_scalar;
+    table.widen_bf16 = widen_bf16_scalar;
+    table.crc32c = crc32c_scalar;
+    table.scale = scale_scalar;
+    table.multiply_accumulate = multiply_accumulate_scalar;
+    table.summarize = summarize_scalar;
+    build_crc32c_table();
+
+#ifdef UADI_X86_DISPATCH
+#ifdef UADI_CRC32C_SSE42
+    /* crc32 is part of SSE4.2, every level from there on uses it. */
+    if(table.isa >= UADI_ISA_SSE42){
+        table.crc32c = crc32c_sse42;
+        build_crc32c_zeros(crc32c_long, CRC32C_LONG);
+        build_crc32c_zeros(crc32c_short, CRC32C_SHORT);
+    }
+#endif
+    switch(table.isa){
+    case UADI_ISA_AVX512:
+        table.fill_iota = fill_iota_avx512;
+        table.fill_iota_stream = fill_iota_stream_avx512;
+        table.scale = scale_avx512;
+        table.multiply_accumulate = multiply_accumulate_avx512;
+        table.summarize = summarize_avx512;
+        table.fill_iota_f16 = fill_iota_f16_avx512;
+        table.fill_iota_bf16 = fill_iota_bf16_avx2;
+#ifdef UADI_AVX512_BF16
+        if(has_avx512_bf16())
+            table.fill_iota_bf16 = fill_iota_bf16_avx512;
+#endif
+        if(has_f16c())
+            table.widen_f16 = widen_f16_avx2;
+        break;
+    case UADI_ISA_AVX2:
+        table.fill_iota = fill_iota_avx2;
+        table.fill_iota_stream = fill_iota_stream_avx2;
+        table.scale = scale_avx2;
+        table.multiply_accumulate = multiply_accumulate_avx2;
+        table.summarize = summarize_avx2;
+        table.fill_iota_bf16 = fill_iota_bf16_avx2;
+        if(has_f16c()){
+            table.fill_iota_f16 = fill_iota_f16_avx2;
+            table.widen_f16 = widen_f16_avx2;
+        }
+        break;
+    case UADI_ISA_SSE42:
+        table.fill_iota = fill_iota_sse42;
+        table.fill_iota_stream = fill_iota_stream_sse42;
+        table.scale = scale_sse42;
+        table.multiply_accumulate = multiply_accumulate_sse42;
+        table.summarize = summarize_sse42;
+        break;
+    case UADI_ISA_SCALAR:
+        break;
+    }
+#endif
+
+    uadi_kernels = table;
+}
+
+void uadi_kernels_init(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, select_kernels);
+}
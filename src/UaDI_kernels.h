@@ -0,0 +1,79 @@
+/**
+ * @file UaDI_kernels.h
+ * @brief Internal dispatch table of the vectorized sample kernels.
+ *
+ * Every kernel exists in a scalar variant and, on x86, in SSE4.2, AVX2 and
+ * AVX-512 variants compiled with function level target attributes. The
+ * library is therefore built without -march flags and selects the best
+ * variant the running CPU supports once, from uadi_init(...).
+ * Half precision kernels additionally use F16C and AVX512-BF16 where the CPU
+ * has them.
+ * Setting the environment variable UADI_ISA to "scalar", "sse4.2", "avx2" or
+ * "avx512" caps the selection, which is used to test every variant on a
+ * single machine. A level the CPU does not support is never selected.
+ */
+
+#ifndef UADI_KERNELS_H
+#define UADI_KERNELS_H
+
+#include <stddef.h>
+
+enum uadi_isa{
+    UADI_ISA_SCALAR,
+    UADI_ISA_SSE42,
+    UADI_ISA_AVX2,
+    UADI_ISA_AVX512
+};
+
+/* Running minimum, maximum and sums of a block of samples. The sums are
+ * floats, callers fold them into doubles every few thousand samples. */
+struct uadi_summary{
+    float minimum;
+    float maximum;
+    float sum;
+    float sum_squares;
+};
+
+struct uadi_kernel_table{
+    enum uadi_isa isa;
+
+    /* Writes count floats of the sawtooth ((value + i) & 255) ^ mask.
+     * A mask of 255 turns the iota into the inverse iota. */
+    void (*fill_iota)(float* samples, size_t count, unsigned int value, unsigned int mask);
+
+    /* Same as fill_iota, but bypasses the caches with non-temporal stores and
+     * ends with a store fence, so the samples are globally visible before the
+     * chunk is handed to another thread. The scalar variant uses regular
+     * stores. */
+    void (*fill_iota_stream)(float* samples, size_t count, unsigned int value, unsigned int mask);
+
+    /* Same as fill_iota, but writes IEEE half precision or bfloat16 samples,
+     * rounded to nearest even. */
+    void (*fill_iota_f16)(unsigned short* samples, size_t count, unsigned int value, unsigned int mask);
+    void (*fill_iota_bf16)(unsigned short* samples, size_t count, unsigned int value, unsigned int mask);
+
+    /* Convert count half precision or bfloat16 samples to floats. */
+    void (*widen_f16)(float* out, unsigned short const* samples, size_t count);
+    void (*widen_bf16)(float* out, unsigned short const* samples, size_t count);
+
+    /* Continues the CRC32C crc, 0 for a new one, over size bytes of data. */
+    unsigned int (*crc32c)(unsigned int crc, void const* data, size_t size);
+
+    /* Pipeline stages: samples[i] = gain * samples[i] + offset,
+     * out[i] += factor * in[i], and folding count samples into a summary
+     * whose minimum and maximum already hold a sample. */
+    void (*scale)(float* samples, size_t count, float gain, float offset);
+    void (*multiply_accumulate)(float* out, float const* in, size_t count, float factor);
+    void (*summarize)(float const* samples, size_t count, struct uadi_summary* summary);
+};
+
+/* Valid after uadi_kernels_init(), read-only afterwards. */
+extern struct uadi_kernel_table uadi_kernels;
+
+/* Selects the kernel variants. Safe to call any number of times from any
+ * thread, the selection only happens once. */
+void uadi_kernels_init(void);
+
+char const* uadi_isa_name(enum uadi_isa isa);
+
+#endif // UADI_KERNELS_H
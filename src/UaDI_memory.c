@@ -0,0 +1,190 @@
+/**
+ * @file UaDI_memory.c
+ * @brief Internal helpers for preparing chunk memory.
+ */
+
+#include "UaDI_memory.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#endif
+
+size_t uadi_page_size(void)
+{
+    static size_t page_size;
+    size_t size = __atomic_load_n(&page_size, __ATOMIC_RELAXED);
+    if(!size){
+#ifdef __linux__
+        long result = sysconf(_SC_PAGESIZE);
+        size = result > 0 ? (size_t)result : 4096;
+#else
+        size = 4096;
+#endif
+        __atomic_store_n(&page_size, size, __ATOMIC_RELAXED);
+    }
+    return size;
+}
+
+void* uadi_aligned_calloc(size_t alignment, size_t size)
+{
+    void* memory;
+#ifdef _WIN32
+    memory = _aligned_malloc(size, alignment);
+#else
+    if(posix_memalign(&memory, alignment, size) != 0)
+        memory = NULL;
+#endif
+    if(memory)
+        memset(memory, 0, size);
+    return memory;
+}
+
+void uadi_aligned_free(void* memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+static void touch_pages(unsigned char* memory, size_t size, size_t page_size)
+{
+    /* Writes the first byte of the memory and of every following page. */
+    uintptr_t address = (uintptr_t)memory;
+    uintptr_t end = address + size;
+    while(address < end){
+        *(volatile unsigned char*)address = 0;
+        address = (address | (page_size - 1)) + 1;
+    }
+}
+
+void uadi_prefault(unsigned char* memory, size_t size)
+{
+    size_t page_size = uadi_page_size();
+#ifdef __linux__
+    static int populate_unsupported;
+    if(!__atomic_load_n(&populate_unsupported, __ATOMIC_RELAXED)){
+        uintptr_t begin = (uintptr_t)memory & ~(uintptr_t)(page_size - 1);
+        uintptr_t end = (uintptr_t)memory + size;
+        if(madvise((void*)begin, end - begin, MADV_POPULATE_WRITE) == 0)
+            return;
+        if(errno == EINVAL)
+            __atomic_store_n(&populate_unsupported, 1, __ATOMIC_RELAXED);
+    }
+#endif
+    touch_pages(memory, size, page_size);
+}
+
+#ifdef __linux__
+
+static int create_memfd(void)
+{
+#ifdef SYS_memfd_create
+    return (int)syscall(SYS_memfd_create, "uadi-mirror", 0u);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void* uadi_mirror_map(size_t size)
+{
+    unsigned char* base;
+    int fd = create_memfd();
+    if(fd < 0)
+        return NULL;
+    if(ftruncate(fd, (off_t)size) != 0){
+        close(fd);
+        return NULL;
+    }
+    /* Reserve both halves first, so nothing else can be mapped in between. */
+    base = (unsigned char*)mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED){
+        close(fd);
+        return NULL;
+    }
+    if(mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+       || mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED){
+        munmap(base, 2 * size);
+        close(fd);
+        return NULL;
+    }
+    /* The mappings keep the memory alive. */
+    close(fd);
+    return base;
+}
+
+void uadi_mirror_unmap(void* memory, size_t size)
+{
+    if(memory)
+        munmap(memory, 2 * size);
+}
+
+void* uadi_pool_map(size_t size, int huge_pages)
+{
+    void* memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if(huge_pages)
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if(memory == MAP_FAILED){
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        /* Only a hint, the pool works without huge pages as well. */
+        if(huge_pages)
+            madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+    return memory;
+}
+
+void uadi_pool_unmap(void* memory, size_t size)
+{
+    if(memory)
+        munmap(memory, size);
+}
+
+#else
+
+void* uadi_mirror_map(size_t size)
+{
+    (void)size;
+    return NULL;
+}
+
+void uadi_mirror_unmap(void* memory, size_t size)
+{
+    (void)memory;
+    (void)size;
+}
+
+void* uadi_pool_map(size_t size, int huge_pages)
+{
+    (void)huge_pages;
+    return uadi_aligned_calloc(uadi_page_size(), size);
+}
+
+void uadi_pool_unmap(void* memory, size_t size)
+{
+    (void)size;
+    uadi_aligned_free(memory);
+}
+
+#endif // __linux__
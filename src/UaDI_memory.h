@@ -0,0 +1,57 @@
+/**
+ * @file UaDI_memory.h
+ * @brief Internal helpers for preparing chunk memory.
+ */
+
+#ifndef UADI_MEMORY_H
+#define UADI_MEMORY_H
+
+#include <stddef.h>
+
+/* Fields written by different threads are kept on separate cache lines, so
+ * the producer and the consumer side don't invalidate each other's lines. */
+#define UADI_CACHE_LINE 64
+#ifdef _MSC_VER
+#define UADI_CACHE_ALIGNED __declspec(align(UADI_CACHE_LINE))
+#else
+#define UADI_CACHE_ALIGNED __attribute__((aligned(UADI_CACHE_LINE)))
+#endif
+
+/* C99 has no _Static_assert, a negative array size fails the build instead. */
+#define UADI_STATIC_ASSERT(condition, name) \
+    typedef char uadi_static_assert_##name[(condition) ? 1 : -1]
+
+/* Zero initialized allocation aligned to alignment, a power of two of at least
+ * sizeof(void*). Must be freed with uadi_aligned_free(). */
+void* uadi_aligned_calloc(size_t alignment, size_t size);
+void uadi_aligned_free(void* memory);
+
+size_t uadi_page_size(void);
+
+/* Faults in every page of [memory, memory + size) for writing, so the
+ * producer doesn't take page faults when it fills the memory for the first
+ * time. Uses MADV_POPULATE_WRITE where the kernel supports it and otherwise
+ * writes one byte per page. The content of the memory is undefined afterwards. */
+void uadi_prefault(unsigned char* memory, size_t size);
+
+/* Maps size bytes of shared memory twice, back to back, so that every range of
+ * up to size bytes starting in the first half is contiguous, even if it wraps
+ * around the end of the buffer. size must be a multiple of the page size.
+ * Returns NULL if the platform doesn't support it (Linux only) or on failure.
+ * Must be unmapped with uadi_mirror_unmap(...) with the same size. */
+void* uadi_mirror_map(size_t size);
+void uadi_mirror_unmap(void* memory, size_t size);
+
+/* Size of the huge pages tried by uadi_pool_map(...). */
+#define UADI_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* Maps size bytes of zeroed, page aligned memory for a library owned chunk
+ * pool. size must be a multiple of the page size, and of UADI_HUGE_PAGE_SIZE
+ * with huge_pages set. With huge_pages the pool is backed by explicit huge
+ * pages where the system has them reserved, and otherwise marked for
+ * transparent huge pages. Returns NULL on failure. Must be unmapped with
+ * uadi_pool_unmap(...) with the same size. */
+void* uadi_pool_map(size_t size, int huge_pages);
+void uadi_pool_unmap(void* memory, size_t size);
+
+#endif // UADI_MEMORY_H
@@ -0,0 +1,71 @@
+/**
+ * @file UaDI_park.c
+ * @brief Internal parking primitive for idle library threads.
+ */
+
+#include "UaDI_park.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void uadi_parker_init(struct uadi_parker* parker)
+{
+    parker->parked = 0;
+#ifndef __linux__
+    pthread_mutex_init(&parker->lock, NULL);
+    pthread_cond_init(&parker->wakeup, NULL);
+#endif
+}
+
+void uadi_parker_destroy(struct uadi_parker* parker)
+{
+#ifndef __linux__
+    pthread_cond_destroy(&parker->wakeup);
+    pthread_mutex_destroy(&parker->lock);
+#else
+    (void)parker;
+#endif
+}
+
+void uadi_parker_prepare(struct uadi_parker* parker)
+{
+    /* Sequentially consistent, so either the waker sees the flag or the
+     * parking thread sees the published work. */
+    __atomic_store_n(&parker->parked, 1, __ATOMIC_SEQ_CST);
+}
+
+void uadi_parker_cancel(struct uadi_parker* parker)
+{
+    __atomic_store_n(&parker->parked, 0, __ATOMIC_RELAXED);
+}
+
+void uadi_parker_wait(struct uadi_parker* parker)
+{
+#ifdef __linux__
+    while(__atomic_load_n(&parker->parked, __ATOMIC_ACQUIRE))
+        syscall(SYS_futex, &parker->parked, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&parker->lock);
+    while(__atomic_load_n(&parker->parked, __ATOMIC_ACQUIRE))
+        pthread_cond_wait(&parker->wakeup, &parker->lock);
+    pthread_mutex_unlock(&parker->lock);
+#endif
+}
+
+void uadi_parker_wake(struct uadi_parker* parker)
+{
+    if(!__atomic_load_n(&parker->parked, __ATOMIC_SEQ_CST))
+        return;
+    if(!__atomic_exchange_n(&parker->parked, 0, __ATOMIC_SEQ_CST))
+        return;
+#ifdef __linux__
+    syscall(SYS_futex, &parker->parked, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&parker->lock);
+    pthread_cond_signal(&parker->wakeup);
+    pthread_mutex_unlock(&parker->lock);
+#endif
+}
@@ -0,0 +1,54 @@
+/**
+ * @file UaDI_park.h
+ * @brief Internal parking primitive for idle library threads.
+ *
+ * A thread that runs out of work announces itself with uadi_parker_prepare,
+ * checks its wait condition once more and then either cancels or sleeps in
+ * uadi_parker_wait. Threads producing work call uadi_parker_wake after 
+ * publishing it, which costs a single atomic exchange as long as nobody is 
+ * parked. On Linux the parker is a futex, elsewhere a mutex and condition
+ * variable.
+ */
+
+#ifndef UADI_PARK_H
+#define UADI_PARK_H
+
+#ifndef __linux__
+#include <pthread.h>
+#endif
+
+struct uadi_parker{
+    int parked;
+#ifndef __linux__
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+#endif
+};
+
+void uadi_parker_init(struct uadi_parker* parker);
+void uadi_parker_destroy(struct uadi_parker* parker);
+
+/* Announces that the calling thread is about to park. The caller must check
+ * its wait condition after this call. */
+void uadi_parker_prepare(struct uadi_parker* parker);
+
+/* Withdraws uadi_parker_prepare when the wait condition became false. */
+void uadi_parker_cancel(struct uadi_parker* parker);
+
+/* Sleeps until uadi_parker_wake is called. May return spuriously. */
+void uadi_parker_wait(struct uadi_parker* parker);
+
+/* Wakes the parked thread, if there is one. */
+void uadi_parker_wake(struct uadi_parker* parker);
+
+/* Hint to the CPU that the calling thread is spinning. */
+static inline void uadi_cpu_relax(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif // UADI_PARK_H
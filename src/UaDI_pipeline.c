@@ -0,0 +1,482 @@
+/**
+ * @file UaDI_pipeline.c
+ * @brief Processing stages and the tiled pipeline running them.
+ */
+
+#include "UaDI_pipeline.h"
+#include "UaDI_expression.h"
+#include "UaDI_kernels.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct stage;
+
+struct stage_type{
+    char const* name;
+    /* Reads the parameters from the stage object. */
+    uadi_status (*create)(struct uadi_json const* json, struct stage** stage);
+    /* Processes count samples in place and returns how many are left. */
+    size_t (*process)(struct stage* stage, float* samples, size_t count);
+    /* Called after the last tile of a chunk, may be NULL. */
+    void (*finish)(struct stage* stage, struct uadi_chunk_header* header);
+    /* Frees what the stage owns besides itself, may be NULL. */
+    void (*destroy)(struct stage* stage);
+};
+
+/* First member of every stage */
+struct stage{
+    struct stage_type const* type;
+    struct uadi_stage_statistics statistics;
+};
+
+struct uadi_pipeline{
+    size_t stage_count;
+    struct stage* stages[UADI_PIPELINE_MAX_STAGES];
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+/* {"stage":"scale","gain":g,"offset":o} computes gain * x + offset. */
+struct scale{
+    struct stage stage;
+    float gain;
+    float offset;
+};
+
+static uadi_status create_scale(struct uadi_json const* json, struct stage** stage)
+{
+    struct scale* scale = (struct scale*)calloc(1, sizeof(*scale));
+    if(!scale)
+        return UADI_INTERNAL_ERROR;
+    scale->gain = (float)uadi_json_number(json, "gain", 1.0);
+    scale->offset = (float)uadi_json_number(json, "offset", 0.0);
+    *stage = &scale->stage;
+    return UADI_SUCCESS;
+}
+
+static size_t process_scale(struct stage* stage, float* samples, size_t count)
+{
+    struct scale* scale = (struct scale*)stage;
+    uadi_kernels.scale(samples, count, scale->gain, scale->offset);
+    return count;
+}
+
+/* {"stage":"fir","taps":[h0, h1, ...]} filters with y[n] = sum h[k] x[n - k].
+ * The window holds the last tap_count - 1 inputs, carried across tiles and
+ * chunks, followed by the current tile. */
+struct fir{
+    struct stage stage;
+    size_t tap_count;
+    float taps[UADI_PIPELINE_MAX_TAPS]; /* reversed, taps[k] = h[tap_count - 1 - k] */
+    float window[UADI_PIPELINE_MAX_TAPS - 1 + UADI_PIPELINE_TILE];
+};
+
+static uadi_status create_fir(struct uadi_json const* json, struct stage** stage)
+{
+    struct uadi_json const* taps = uadi_json_member(json, "taps");
+    struct uadi_json const* tap;
+    struct fir* fir;
+    size_t count = 0;
+
+    if(!taps || taps->type != UADI_JSON_ARRAY)
+        return UADI_ERROR;
+    for(tap = taps->child; tap; tap = tap->next){
+        if(tap->type != UADI_JSON_NUMBER)
+            return UADI_ERROR;
+        ++count;
+    }
+    if(!count || count > UADI_PIPELINE_MAX_TAPS)
+        return UADI_ERROR;
+    fir = (struct fir*)calloc(1, sizeof(*fir));
+    if(!fir)
+        return UADI_INTERNAL_ERROR;
+    fir->tap_count = count;
+    for(tap = taps->child; tap; tap = tap->next)
+        fir->taps[--count] = (float)tap->number;
+    *stage = &fir->stage;
+    return UADI_SUCCESS;
+}
+
+static size_t process_fir(struct stage* stage, float* samples, size_t count)
+{
+    struct fir* fir = (struct fir*)stage;
+    size_t history = fir->tap_count - 1;
+    size_t k;
+
+    memcpy(fir->window + history, samples, count * sizeof(float));
+    /* Tap by tap over the whole tile, which keeps the vectors full for any
+     * number of taps. */
+    memset(samples, 0, count * sizeof(float));
+    for(k = 0; k < fir->tap_count; ++k)
+        uadi_kernels.multiply_accumulate(samples, fir->window + k, count, fir->taps[k]);
+    memmove(fir->window, fir->window + count, history * sizeof(float));
+    return count;
+}
+
+/* {"stage":"decimate","factor":n} keeps every n-th sample, continuing the
+ * phase across chunks. Usually preceded by a low-pass fir stage. */
+struct decimate{
+    struct stage stage;
+    size_t factor;
+    size_t phase; /* inputs since the last kept sample, modulo factor */
+};
+
+static uadi_status create_decimate(struct uadi_json const* json, struct stage** stage)
+{
+    double factor = uadi_json_number(json, "factor", 0.0);
+    struct decimate* decimate;
+
+    if(factor < 1.0 || factor > 65536.0 || factor != floor(factor))
+        return UADI_ERROR;
+    decimate = (struct decimate*)calloc(1, sizeof(*decimate));
+    if(!decimate)
+        return UADI_INTERNAL_ERROR;
+    decimate->factor = (size_t)factor;
+    *stage = &decimate->stage;
+    return UADI_SUCCESS;
+}
+
+static size_t process_decimate(struct stage* stage, float* samples, size_t count)
+{
+    struct decimate* decimate = (struct decimate*)stage;
+    size_t kept = 0;
+    size_t i;
+
+    for(i = (decimate->factor - decimate->phase) % decimate->factor; i < count; i += decimate->factor)
+        samples[kept++] = samples[i];
+    decimate->phase = (decimate->phase + count) % decimate->factor;
+    return kept;
+}
+
+/* {"stage":"statistics"} reports minimum, maximum, mean and root mean square
+ * of the samples of the last chunk in results[0] to results[3]. */
+struct statistics{
+    struct stage stage;
+    float minimum;
+    float maximum;
+    double sum;
+    double sum_squares;
+    size_t count; /* samples of the current chunk */
+};
+
+static uadi_status create_statistics(struct uadi_json const* json, struct stage** stage)
+{
+    struct statistics* statistics = (struct statistics*)calloc(1, sizeof(*statistics));
+    (void)json;
+    if(!statistics)
+        return UADI_INTERNAL_ERROR;
+    *stage = &statistics->stage;
+    return UADI_SUCCESS;
+}
+
+static size_t process_statistics(struct stage* stage, float* samples, size_t count)
+{
+    struct statistics* statistics = (struct statistics*)stage;
+    struct uadi_summary summary;
+
+    if(!count)
+        return count;
+    summary.minimum = statistics->count ? statistics->minimum : samples[0];
+    summary.maximum = statistics->count ? statistics->maximum : samples[0];
+    summary.sum = 0.0f;
+    summary.sum_squares = 0.0f;
+    /* Float sums over one tile, folded into doubles per tile. */
+    uadi_kernels.summarize(samples, count, &summary);
+    statistics->minimum = summary.minimum;
+    statistics->maximum = summary.maximum;
+    statistics->sum += summary.sum;
+    statistics->sum_squares += summary.sum_squares;
+    statistics->count += count;
+    return count;
+}
+
+static void finish_statistics(struct stage* stage, struct uadi_chunk_header* header)
+{
+    struct statistics* statistics = (struct statistics*)stage;
+    (void)header;
+    if(!statistics->count)
+        return;
+    stage->statistics.results[0] = statistics->minimum;
+    stage->statistics.results[1] = statistics->maximum;
+    stage->statistics.results[2] = statistics->sum / (double)statistics->count;
+    stage->statistics.results[3] = sqrt(statistics->sum_squares / (double)statistics->count);
+    statistics->sum = 0.0;
+    statistics->sum_squares = 0.0;
+    statistics->count = 0;
+}
+
+/* {"stage":"trigger","level":l,"edge":"rising"|"falling"} flags chunks in
+ * which the signal crosses the level with UADI_CHUNK_TRIGGERED and stores
+ * the index of the first sample past the crossing in trigger_sample. The
+ * index counts the samples reaching the trigger, stages after it must not
+ * drop samples for it to index the datapack. results[0] counts the triggered
+ * chunks. */
+struct trigger{
+    struct stage stage;
+    float level;
+    int rising;
+    int primed;       /* last holds a sample */
+    float last;       /* last sample seen, also of the previous chunk */
+    int found;        /* crossed in the current chunk */
+    size_t first;     /* index of the first crossing in the current chunk */
+    size_t seen;      /* samples seen in the current chunk */
+};
+
+static uadi_status create_trigger(struct uadi_json const* json, struct stage** stage)
+{
+    char const* edge = uadi_json_string(json, "edge");
+    struct trigger* trigger;
+
+    if(edge && strcmp(edge, "rising") != 0 && strcmp(edge, "falling") != 0)
+        return UADI_ERROR;
+    trigger = (struct trigger*)calloc(1, sizeof(*trigger));
+    if(!trigger)
+        return UADI_INTERNAL_ERROR;
+    trigger->level = (float)uadi_json_number(json, "level", 0.0);
+    trigger->rising = !edge || strcmp(edge, "rising") == 0;
+    *stage = &trigger->stage;
+    return UADI_SUCCESS;
+}
+
+static size_t process_trigger(struct stage* stage, float* samples, size_t count)
+{
+    struct trigger* trigger = (struct trigger*)stage;
+    float level = trigger->level;
+    float last = trigger->last;
+    size_t i;
+
+    if(!count)
+        return count;
+    if(!trigger->found){
+        i = 0;
+        if(!trigger->primed)
+            last = samples[i++];
+        for(; i < count; ++i){
+            if(trigger->rising ? last < level && samples[i] >= level
+                               : last > level && samples[i] <= level){
+                trigger->found = 1;
+                trigger->first = trigger->seen + i;
+                break;
+            }
+            last = samples[i];
+        }
+    }
+    trigger->primed = 1;
+    trigger->last = samples[count - 1];
+    trigger->seen += count;
+    return count;
+}
+
+static void finish_trigger(struct stage* stage, struct uadi_chunk_header* header)
+{
+    struct trigger* trigger = (struct trigger*)stage;
+    if(trigger->found){
+        header->flags |= UADI_CHUNK_TRIGGERED;
+        header->trigger_sample = (unsigned int)trigger->first;
+        stage->statistics.results[0] += 1.0;
+    }
+    trigger->found = 0;
+    trigger->seen = 0;
+}
+
+/* {"stage":"expression","expression":"sqrt(i*i + q*q)","channels":["i","q"]}
+ * replaces every frame of interleaved channels by the value of the
+ * expression, see UaDI_expression.h. Without channels every sample is a
+ * frame of its own, named x. A frame split by the end of a tile or chunk is
+ * kept until the rest of it arrives. */
+struct expression{
+    struct stage stage;
+    struct uadi_expression* expression;
+    size_t channel_count;
+    float pending[UADI_EXPRESSION_MAX_CHANNELS]; /* beginning of a split frame */
+    size_t pending_count;
+};
+
+static uadi_status create_expression(struct uadi_json const* json, struct stage** stage)
+{
+    char const* text = uadi_json_string(json, "expression");
+    struct uadi_json const* channels = uadi_json_member(json, "channels");
+    struct uadi_json const* channel;
+    char const* names[UADI_EXPRESSION_MAX_CHANNELS] = {"x"};
+    size_t count = 0;
+    struct expression* expression;
+    uadi_status status;
+
+    if(channels){
+        if(channels->type != UADI_JSON_ARRAY)
+            return UADI_ERROR;
+        for(channel = channels->child; channel; channel = channel->next){
+            if(channel->type != UADI_JSON_STRING || count == UADI_EXPRESSION_MAX_CHANNELS)
+                return UADI_ERROR;
+            names[count++] = channel->string;
+        }
+    } else {
+        count = 1;
+    }
+    expression = (struct expression*)calloc(1, sizeof(*expression));
+    if(!expression)
+        return UADI_INTERNAL_ERROR;
+    status = uadi_expression_compile(text, names, count, &expression->expression);
+    if(status != UADI_SUCCESS){
+        free(expression);
+        return status;
+    }
+    expression->channel_count = count;
+    *stage = &expression->stage;
+    return UADI_SUCCESS;
+}
+
+static size_t process_expression(struct stage* stage, float* samples, size_t count)
+{
+    struct expression* expression = (struct expression*)stage;
+    size_t channels = expression->channel_count;
+    size_t used = 0;
+    size_t kept = 0;
+    size_t frames;
+
+    if(expression->pending_count){
+        used = channels - expression->pending_count;
+        if(used > count){
+            memcpy(expression->pending + expression->pending_count, samples, count * sizeof(float));
+            expression->pending_count += count;
+            return 0;
+        }
+        memcpy(expression->pending + expression->pending_count, samples, used * sizeof(float));
+        uadi_expression_evaluate(expression->expression, samples, expression->pending, 1);
+        kept = 1;
+    }
+    frames = (count - used) / channels;
+    uadi_expression_evaluate(expression->expression, samples + kept, samples + used, frames);
+    used += frames * channels;
+    expression->pending_count = count - used;
+    memcpy(expression->pending, samples + used, expression->pending_count * sizeof(float));
+    return kept + frames;
+}
+
+static void destroy_expression(struct stage* stage)
+{
+    uadi_expression_destroy(((struct expression*)stage)->expression);
+}
+
+static struct stage_type const stage_types[] = {
+    {"scale", create_scale, process_scale, NULL, NULL},
+    {"fir", create_fir, process_fir, NULL, NULL},
+    {"decimate", create_decimate, process_decimate, NULL, NULL},
+    {"statistics", create_statistics, process_statistics, finish_statistics, NULL},
+    {"trigger", create_trigger, process_trigger, finish_trigger, NULL},
+    {"expression", create_expression, process_expression, NULL, destroy_expression},
+};
+
+#define STAGE_TYPE_COUNT (sizeof(stage_types) / sizeof(stage_types[0]))
+
+static uadi_status create_stage(struct uadi_json const* json, struct stage** stage)
+{
+    char const* name = uadi_json_string(json, "stage");
+    uadi_status status;
+    size_t i;
+
+    if(!name)
+        return UADI_ERROR;
+    for(i = 0; i < STAGE_TYPE_COUNT; ++i){
+        if(strcmp(name, stage_types[i].name) != 0)
+            continue;
+        status = stage_types[i].create(json, stage);
+        if(status != UADI_SUCCESS)
+            return status;
+        (*stage)->type = &stage_types[i];
+        strncpy((*stage)->statistics.stage, name, sizeof((*stage)->statistics.stage) - 1);
+        return UADI_SUCCESS;
+    }
+    return UADI_ERROR;
+}
+
+uadi_status uadi_pipeline_create(struct uadi_json const* stages, struct uadi_pipeline** pipeline)
+{
+    struct uadi_json const* json;
+    struct uadi_pipeline* created;
+    uadi_status status;
+
+    if(!stages || stages->type != UADI_JSON_ARRAY)
+        return UADI_ERROR;
+    created = (struct uadi_pipeline*)calloc(1, sizeof(*created));
+    if(!created)
+        return UADI_INTERNAL_ERROR;
+    for(json = stages->child; json; json = json->next){
+        if(created->stage_count == UADI_PIPELINE_MAX_STAGES){
+            uadi_pipeline_destroy(created);
+            return UADI_ERROR;
+        }
+        status = create_stage(json, &created->stages[created->stage_count]);
+        if(status != UADI_SUCCESS){
+            uadi_pipeline_destroy(created);
+            return status;
+        }
+        ++created->stage_count;
+    }
+    *pipeline = created;
+    return UADI_SUCCESS;
+}
+
+void uadi_pipeline_destroy(struct uadi_pipeline* pipeline)
+{
+    size_t i;
+    if(!pipeline)
+        return;
+    for(i = 0; i < pipeline->stage_count; ++i){
+        if(pipeline->stages[i]->type->destroy)
+            pipeline->stages[i]->type->destroy(pipeline->stages[i]);
+        free(pipeline->stages[i]);
+    }
+    free(pipeline);
+}
+
+void uadi_pipeline_run(struct uadi_pipeline* pipeline, float* samples, struct uadi_chunk_header* header)
+{
+    size_t total = header->sample_count;
+    size_t kept = 0;
+    size_t begin, count, i;
+    unsigned long long then, now;
+    struct stage* stage;
+
+    for(begin = 0; begin < total; begin += UADI_PIPELINE_TILE){
+        count = total - begin < UADI_PIPELINE_TILE ? total - begin : UADI_PIPELINE_TILE;
+        then = now_ns();
+        for(i = 0; i < pipeline->stage_count && count; ++i){
+            stage = pipeline->stages[i];
+            stage->statistics.samples += count;
+            count = stage->type->process(stage, samples + begin, count);
+            now = now_ns();
+            stage->statistics.busy_ns += now - then;
+            then = now;
+        }
+        /* Kept samples never run ahead of the tile they come from. */
+        if(kept != begin)
+            memmove(samples + kept, samples + begin, count * sizeof(float));
+        kept += count;
+    }
+    for(i = 0; i < pipeline->stage_count; ++i){
+        stage = pipeline->stages[i];
+        ++stage->statistics.chunks;
+        if(stage->type->finish)
+            stage->type->finish(stage, header);
+    }
+    header->sample_count = (unsigned int)kept;
+    header->data_size = kept * sizeof(float);
+}
+
+size_t uadi_pipeline_statistics(struct uadi_pipeline const* pipeline,
+                                struct uadi_stage_statistics* stages, size_t count)
+{
+    size_t i;
+    for(i = 0; i < count && i < pipeline->stage_count; ++i)
+        stages[i] = pipeline->stages[i]->statistics;
+    return pipeline->stage_count;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file UaDI_pipeline.h
+ * @brief Internal chain of processing stages run by the producer on every chunk.
+ *
+ * A pipeline is built from the "stages" array of the JSON command
+ * {"command":"pipeline"} and processes float32 datapacks in place right
+ * after they are filled. Instead of running every stage over the whole
+ * chunk, the chunk is cut into tiles of UADI_PIPELINE_TILE samples that stay
+ * in the L1 cache, and each tile passes through all stages before the next
+ * one is loaded. Stages that drop samples, like decimation, shrink the tile;
+ * the shrunk tiles are packed to the front of the chunk.
+ * A pipeline belongs to one producer and isn't thread safe, the core guards
+ * it with a lock when it is replaced or its statistics are read.
+ */
+
+#ifndef UADI_PIPELINE_H
+#define UADI_PIPELINE_H
+
+#include "UaDI_json.h"
+#include "UaDI_template.h"
+
+#include <stddef.h>
+
+/* Samples per tile, 16 KiB of floats */
+#define UADI_PIPELINE_TILE 4096
+
+/* Most stages per pipeline and taps per FIR stage */
+#define UADI_PIPELINE_MAX_STAGES 16
+#define UADI_PIPELINE_MAX_TAPS 256
+
+struct uadi_pipeline;
+
+/* Builds a pipeline from a JSON array of stage objects. Returns UADI_ERROR
+ * for an unknown stage or invalid parameters, UADI_INTERNAL_ERROR when out
+ * of memory. */
+uadi_status uadi_pipeline_create(struct uadi_json const* stages, struct uadi_pipeline** pipeline);
+
+void uadi_pipeline_destroy(struct uadi_pipeline* pipeline);
+
+/* Runs the filled datapack of header->sample_count samples through all
+ * stages and updates sample_count, data_size and flags of the header. */
+void uadi_pipeline_run(struct uadi_pipeline* pipeline, float* samples, struct uadi_chunk_header* header);
+
+/* Copies the statistics of up to count stages and returns the number of
+ * stages of the pipeline. */
+size_t uadi_pipeline_statistics(struct uadi_pipeline const* pipeline,
+                                struct uadi_stage_statistics* stages, size_t count);
+
+#endif // UADI_PIPELINE_H
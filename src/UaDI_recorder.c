@@ -0,0 +1,172 @@
+/**
+ * @file UaDI_recorder.c
+ * @brief Double buffered flight recorder and its dump thread.
+ */
+
+#include "UaDI_recorder.h"
+#include "UaDI_memory.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct recording{
+    unsigned char* data;                /* chunk_count chunks */
+    struct uadi_chunk_header* headers;  /* one per chunk */
+    size_t count;                       /* chunks recorded, at most chunk_count */
+    size_t next;                        /* slot of the next chunk */
+};
+
+struct uadi_recorder{
+    pthread_mutex_t lock; /* guards everything but the frozen recording */
+    size_t chunk_count;
+    size_t chunk_size;
+    struct recording recordings[2];
+    int active;           /* recording the producer writes to */
+    int dumping;          /* the other recording is being written */
+    int dump_started;     /* dump_thread has to be joined */
+    pthread_t dump_thread;
+    char* path;
+    unsigned long long dumps_written; /* atomic, read without the lock */
+    unsigned long long dumps_failed;  /* atomic, read without the lock */
+};
+
+static void free_recording(struct recording* recording)
+{
+    uadi_aligned_free(recording->data);
+    free(recording->headers);
+}
+
+struct uadi_recorder* uadi_recorder_create(size_t chunk_count, size_t chunk_size)
+{
+    struct uadi_recorder* recorder;
+    int i;
+
+    if(!chunk_count || chunk_size > (size_t)-1 / chunk_count)
+        return NULL;
+    recorder = (struct uadi_recorder*)calloc(1, sizeof(*recorder));
+    if(!recorder)
+        return NULL;
+    recorder->chunk_count = chunk_count;
+    recorder->chunk_size = chunk_size;
+    for(i = 0; i < 2; ++i){
+        recorder->recordings[i].data =
+            (unsigned char*)uadi_aligned_calloc(UADI_CACHE_LINE, chunk_count * chunk_size);
+        recorder->recordings[i].headers =
+            (struct uadi_chunk_header*)calloc(chunk_count, sizeof(struct uadi_chunk_header));
+        if(!recorder->recordings[i].data || !recorder->recordings[i].headers){
+            free_recording(&recorder->recordings[0]);
+            free_recording(&recorder->recordings[1]);
+            free(recorder);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&recorder->lock, NULL);
+    return recorder;
+}
+
+void uadi_recorder_destroy(struct uadi_recorder* recorder)
+{
+    if(!recorder)
+        return;
+    if(recorder->dump_started)
+        pthread_join(recorder->dump_thread, NULL);
+    pthread_mutex_destroy(&recorder->lock);
+    free_recording(&recorder->recordings[0]);
+    free_recording(&recorder->recordings[1]);
+    free(recorder->path);
+    free(recorder);
+}
+
+void uadi_recorder_record(struct uadi_recorder* recorder,
+                          struct uadi_chunk_header const* header, void const* data)
+{
+    struct recording* recording;
+    pthread_mutex_lock(&recorder->lock);
+    recording = &recorder->recordings[recorder->active];
+    recording->headers[recording->next] = *header;
+    memcpy(recording->data + recording->next * recorder->chunk_size, data,
+           (size_t)header->data_size < recorder->chunk_size ? (size_t)header->data_size
+                                                           : recorder->chunk_size);
+    recording->next = (recording->next + 1) % recorder->chunk_count;
+    if(recording->count < recorder->chunk_count)
+        ++recording->count;
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+/* Writes the frozen recording oldest chunk first, every chunk as its header
+ * followed by data_size bytes. */
+static void* dump_thread(void* arg)
+{
+    struct uadi_recorder* recorder = (struct uadi_recorder*)arg;
+    struct recording* recording = &recorder->recordings[!recorder->active];
+    size_t first = (recording->next + recorder->chunk_count - recording->count)
+        % recorder->chunk_count;
+    size_t slot;
+    size_t i;
+    int ok;
+    FILE* out = fopen(recorder->path, "wb");
+
+    ok = out != NULL;
+    for(i = 0; ok && i < recording->count; ++i){
+        slot = (first + i) % recorder->chunk_count;
+        ok = fwrite(&recording->headers[slot], sizeof(struct uadi_chunk_header), 1, out) == 1
+            && fwrite(recording->data + slot * recorder->chunk_size,
+                      (size_t)recording->headers[slot].data_size, 1, out) == 1;
+    }
+    if(out && fclose(out) != 0)
+        ok = 0;
+
+    pthread_mutex_lock(&recorder->lock);
+    recording->count = 0;
+    recording->next = 0;
+    __atomic_fetch_add(ok ? &recorder->dumps_written : &recorder->dumps_failed, 1, __ATOMIC_RELAXED);
+    recorder->dumping = 0;
+    pthread_mutex_unlock(&recorder->lock);
+    return NULL;
+}
+
+uadi_status uadi_recorder_freeze(struct uadi_recorder* recorder, char const* path)
+{
+    char* copy = (char*)malloc(strlen(path) + 1);
+    if(!copy)
+        return UADI_INTERNAL_ERROR;
+    strcpy(copy, path);
+
+    pthread_mutex_lock(&recorder->lock);
+    if(recorder->dumping || recorder->recordings[recorder->active].count == 0){
+        pthread_mutex_unlock(&recorder->lock);
+        free(copy);
+        return UADI_ERROR;
+    }
+    /* The previous dump thread has finished, it cleared dumping. */
+    if(recorder->dump_started){
+        pthread_join(recorder->dump_thread, NULL);
+        recorder->dump_started = 0;
+    }
+    free(recorder->path);
+    recorder->path = copy;
+    recorder->active = !recorder->active;
+    recorder->dumping = 1;
+    if(pthread_create(&recorder->dump_thread, NULL, dump_thread, recorder) != 0){
+        /* Recording continues from the frozen chunks. */
+        recorder->active = !recorder->active;
+        recorder->dumping = 0;
+        pthread_mutex_unlock(&recorder->lock);
+        return UADI_INTERNAL_ERROR;
+    }
+    recorder->dump_started = 1;
+    pthread_mutex_unlock(&recorder->lock);
+    return UADI_SUCCESS;
+}
+
+unsigned long long uadi_recorder_dumps_written(struct uadi_recorder const* recorder)
+{
+    return __atomic_load_n(&recorder->dumps_written, __ATOMIC_RELAXED);
+}
+
+unsigned long long uadi_recorder_dumps_failed(struct uadi_recorder const* recorder)
+{
+    return __atomic_load_n(&recorder->dumps_failed, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file UaDI_recorder.h
+ * @brief Internal flight recorder keeping the most recent chunks of a device.
+ *
+ * The recorder holds two buffers of chunk_count chunks each. The producer
+ * copies every filled chunk into the active buffer, overwriting the oldest
+ * one. A freeze swaps the buffers under the recorder lock, which takes as
+ * long as copying one chunk at most, and a separate thread writes the frozen
+ * buffer to disk while recording continues into the other one.
+ */
+
+#ifndef UADI_RECORDER_H
+#define UADI_RECORDER_H
+
+#include "UaDI_template.h"
+
+#include <stddef.h>
+
+struct uadi_recorder;
+
+/* Returns NULL when out of memory. */
+struct uadi_recorder* uadi_recorder_create(size_t chunk_count, size_t chunk_size);
+
+/* Waits for a dump that is still being written. */
+void uadi_recorder_destroy(struct uadi_recorder* recorder);
+
+/* Called by the producer for every filled chunk. */
+void uadi_recorder_record(struct uadi_recorder* recorder,
+                          struct uadi_chunk_header const* header, void const* data);
+
+/* Freezes the recorded chunks and starts writing them to path. Returns
+ * UADI_ERROR if the previous dump is still being written or nothing has been
+ * recorded yet. */
+uadi_status uadi_recorder_freeze(struct uadi_recorder* recorder, char const* path);
+
+/* Number of dumps written completely / that failed, without taking the lock
+ * the producer holds while recording a chunk. */
+unsigned long long uadi_recorder_dumps_written(struct uadi_recorder const* recorder);
+unsigned long long uadi_recorder_dumps_failed(struct uadi_recorder const* recorder);
+
+#endif // UADI_RECORDER_H
@@ -4,84 +4,1811 @@
  * @author Stephan Bökelmann
  * @email sboekelmann@ep1.rub.de
  *
- * In order for the OmniView project and its interface to a UaDI compatible data producer device to be understandable, this DLL shall provide an example on how the interface is supposed to be used. 
- * This particular DLL will generate an integer every ms adding one to the previous value. This way a sawtooth wave is generated.
- * A consumer initializing a new connection shall result in a new thread started. 
+ * In order for the OmniView project and its interface to a UaDI compatible data producer device to be understandable, this DLL shall provide an example on how the interface is supposed to be used.
+ * This particular DLL will generate a sawtooth wave of floats counting from 0 to 255, or from 255 to 0 for the inverse iota device.
+ * Claiming a device results in a new thread started, that fills every chunk pushed by the consumer and hands it back through the receive callback.
+ * This file is the driver independent core; the devices themselves are drivers, see UaDI_driver.h.
  */
 
 #include "UaDI_template.h"
+#include "UaDI_driver.h"
+#include "UaDI_json.h"
+#include "UaDI_kernels.h"
+#include "UaDI_memory.h"
+#include "UaDI_park.h"
+#include "UaDI_pipeline.h"
+#include "UaDI_recorder.h"
+#include "UaDI_trace.h"
+#include "UaDI_wheel.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#ifndef UADI_VERSION
+#define UADI_VERSION "0.0.0"
+#endif
+
+/* Number of chunks a device can hold at once. Must be a power of two. */
+#define UADI_FREE_RING_CAPACITY 4096
+
+/* Number of chunk descriptors per device, which is also the number of filled
+ * chunks that can wait for delivery. Must be a power of two. */
+#define UADI_DESCRIPTOR_COUNT 256
+
+/* Number of threads of the delivery pool of a connection. */
+#define UADI_DELIVERY_THREADS 2
+
+/* Resolution of the timing wheel driving paced devices. */
+#define UADI_PACER_TICK_NS 100000ull
+
+/* Chunks a paced device fills at most per expiry to catch up with its rate. */
+#define UADI_PACER_BATCH 16
+
+/* A started group sleeps until this long before its deadline and polls the
+ * clock for the rest, so the producers don't depend on the wakeup latency of
+ * the kernel. Polling yields, so producers sharing a core all get to run. */
+#define UADI_START_SPIN_NS 200000ull
+
+/* Longest sleep of a producer waiting for the start deadline, so a release
+ * during a long lead time doesn't wait for the whole lead time. */
+#define UADI_START_SLEEP_NS 1000000ull
+
+/* Pacing states of a device */
+#define PACING_OFF 0       /* not in the wheel */
+#define PACING_SCHEDULED 1 /* waiting in the wheel */
+#define PACING_RUNNING 2   /* expired, being filled by the pacer thread */
+
+/* Values of armed besides 0, both count as armed */
+#define ARMED 1          /* claimed with start_armed or stopped */
+#define ARMED_STARTING 2 /* taken by a uadi_start_group in progress */
+
+/* Every device this library offers, one driver each. */
+static struct uadi_driver const* const drivers[] = {
+    &uadi_iota_driver,
+    &uadi_inverse_iota_driver,
+};
+#define DRIVER_COUNT (sizeof(drivers) / sizeof(drivers[0]))
+
+/* Devices are claimed exclusively across all connections. The claim flags
+ * and the kernel table are the only state shared between connections, and
+ * the flags are only touched by a compare-and-swap at claim and release. */
+static int claimed[DRIVER_COUNT];
+
+struct device;
+
+/* Threads running the receive callbacks of UADI_DELIVERY_POOL devices. A
+ * device with filled chunks is queued once; the thread that takes it
+ * delivers its chunks in sequence until none are left, so the chunks of one
+ * device are never delivered concurrently or out of order. */
+struct delivery_pool{
+    pthread_mutex_t lock;  /* guards the queue and stop */
+    pthread_cond_t wakeup;  /* a device was queued or the pool is stopped */
+    pthread_cond_t drained; /* a device was unscheduled */
+    struct device* queue_head;
+    struct device* queue_tail;
+    int stop;
+    size_t thread_count;
+    pthread_t threads[UADI_DELIVERY_THREADS];
+};
+
+/* Drives all paced devices of a connection from a single thread. Each device
+ * is a timer in the wheel; all devices expiring in the same tick are filled
+ * in one batch. */
+struct pacer{
+    pthread_mutex_t lock; /* guards everything below and the pacing fields */
+    pthread_cond_t wakeup; /* a device was added or the pacer is stopped */
+    pthread_cond_t idle;   /* devices left PACING_RUNNING */
+    struct uadi_wheel wheel;
+    unsigned long long origin_ns; /* time of tick 0 */
+    int started;
+    int stop;
+    pthread_t thread;
+};
+
+/* Everything a consumer connection owns. Nothing in here is shared with other
+ * connections, so independent consumers never contend with each other. */
 struct connection{
-    thread* thread;
-    //list of devices
+    pthread_mutex_t lock; /* guards devices, released and starting the pool */
+    struct device* devices;
+    struct uadi_statistics released; /* totals of already released devices */
+    struct delivery_pool pool;
+    struct pacer pacer;
+    struct uadi_trace_clock trace_origin; /* time zero of exported traces */
 };
 
+/* Per-chunk descriptor, the entries of the filled queue of a device. The
+ * header and the chunk are written by the producer while it fills the chunk,
+ * the last line by whoever runs the receive callback once the chunk has been
+ * handed over. The producer doesn't reuse a descriptor before its chunk has
+ * been consumed. */
+struct chunk_descriptor{
+    /* producer-owned */
+    UADI_CACHE_ALIGNED struct uadi_chunk_header header;
+    UADI_CACHE_ALIGNED uadi_chunk_ptr chunk;
+    uadi_status status; /* of the driver's fill_chunk */
+    /* consumer-owned */
+    UADI_CACHE_ALIGNED unsigned long long consumed; /* sequence + 1 once done */
+};
+
+UADI_STATIC_ASSERT(sizeof(struct uadi_chunk_header) == UADI_CACHE_LINE, chunk_header_is_one_line);
+UADI_STATIC_ASSERT(offsetof(struct chunk_descriptor, chunk) == UADI_CACHE_LINE, descriptor_producer_lines);
+UADI_STATIC_ASSERT(offsetof(struct chunk_descriptor, consumed) == 2 * UADI_CACHE_LINE, descriptor_consumer_line);
+UADI_STATIC_ASSERT(sizeof(struct chunk_descriptor) == 3 * UADI_CACHE_LINE, descriptor_is_three_lines);
+
+/* Device control block. The fields are grouped by the thread writing them:
+ * - read-mostly: set at claim time, read by every thread afterwards.
+ * - consumer-owned: written by the thread calling uadi_push_chunks.
+ * - producer-owned: written by the producer thread.
+ * - delivery-owned: written by the thread running the receive callback, the
+ *   producer thread or a delivery pool thread.
+ * - history: the latest samples, written by the producer, read by
+ *   uadi_peek_latest.
+ * - wakeup: only written when the producer goes idle, is woken or stopped.
+ * - pacing: the timer of a paced device, guarded by the pacer lock.
+ * Each group starts on its own cache line, so pushing chunks and filling them
+ * don't bounce lines between the two threads. Each side keeps a cached copy
+ * of the other side's ring index and only reads the shared one when the
+ * cached one says the ring is full or empty. */
 struct device{
-    //id
-    //state of the device
+    /* read-mostly */
+    struct connection* connection;
+    struct uadi_driver const* driver;
+    size_t driver_index;
+    void* driver_state;
+    int driver_opened; /* open succeeded and close is still due */
+    uadi_receive_callback receive_callback;
+    void* receive_context;
+    uadi_recycle_unused_chunk_callback recycle_callback;
+    void* recycle_context;
+    struct uadi_device_options options;
+    int non_temporal;
+    struct uadi_trace_ring* trace[UADI_TRACE_WRITERS]; /* NULL unless tracing */
+    unsigned char* mirror; /* NULL unless options.mirror_size */
+    unsigned char* pool; /* NULL unless options.pool_chunks */
+    size_t pool_size; /* bytes mapped for the pool */
+    size_t pool_stride; /* bytes from one pool chunk to the next */
+    unsigned char* pool_lent; /* per pool chunk, 1 from delivery to release */
+    float* history; /* NULL unless options.latest_samples */
+    size_t history_mask;
+    struct uadi_recorder* recorder; /* NULL unless options.recorder_chunks */
+    unsigned long long period_ns; /* time per chunk of a paced device, else 0 */
+    int armed; /* ARMED or ARMED_STARTING until started (again), else 0 */
+    unsigned long long start_ns; /* deadline given by uadi_start_group */
+
+    /* consumer-owned */
+    UADI_CACHE_ALIGNED size_t ring_tail;
+    size_t cached_head;
+    unsigned long long chunks_pushed;
+    unsigned long long pushes_rejected;
+    unsigned long long chunks_warmed;
+
+    /* producer-owned */
+    UADI_CACHE_ALIGNED size_t ring_head;
+    size_t cached_tail;
+    unsigned long long sequence; /* chunks filled and published for delivery */
+    unsigned long long stream_offset; /* bytes of all datapacks published so far */
+    unsigned long long producer_waits;
+    unsigned long long producer_parks;
+    int producer_state;
+    unsigned long long producer_stalls;
+
+    /* delivery-owned */
+    UADI_CACHE_ALIGNED unsigned long long delivered; /* chunks delivered */
+    int scheduled; /* queued in or taken by the delivery pool */
+    struct device* pool_next; /* guarded by the pool lock */
+
+    /* history, a seqlock over the sample ring: the producer announces the
+     * samples it is about to overwrite in begun and publishes them in written */
+    UADI_CACHE_ALIGNED unsigned long long history_begun;
+    unsigned long long history_written;
+    unsigned long long history_timestamp; /* CLOCK_MONOTONIC of written */
+
+    /* wakeup */
+    UADI_CACHE_ALIGNED struct uadi_parker parker;
+    int running;
+    pthread_t thread;
+    struct device* next; /* guarded by the connection lock */
+    unsigned long long chunks_returned; /* written after the producer stopped */
+
+    /* pacing */
+    UADI_CACHE_ALIGNED struct uadi_timer timer;
+    int pacing;
+    unsigned long long due_ns; /* when the next chunk is due */
+
+    /* pipeline, replaced by uadi_send_json while the producer runs it */
+    UADI_CACHE_ALIGNED pthread_mutex_t pipeline_lock;
+    struct uadi_pipeline* pipeline; /* NULL unless set, guarded by pipeline_lock */
+
+    /* Free ring: written by uadi_push_chunks, read by the producer thread. */
+    UADI_CACHE_ALIGNED uadi_chunk_ptr ring[UADI_FREE_RING_CAPACITY];
+    struct chunk_descriptor descriptors[UADI_DESCRIPTOR_COUNT];
 };
 
+UADI_STATIC_ASSERT(offsetof(struct device, ring_tail) % UADI_CACHE_LINE == 0, consumer_fields_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, ring_head) % UADI_CACHE_LINE == 0, producer_fields_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, delivered) % UADI_CACHE_LINE == 0, delivery_fields_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, history_begun) % UADI_CACHE_LINE == 0, history_fields_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, parker) % UADI_CACHE_LINE == 0, wakeup_fields_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, timer) % UADI_CACHE_LINE == 0, pacing_fields_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, ring) % UADI_CACHE_LINE == 0, ring_aligned);
+UADI_STATIC_ASSERT(offsetof(struct device, ring_head) - offsetof(struct device, ring_tail) <= 2 * UADI_CACHE_LINE,
+                   consumer_fields_fit);
+UADI_STATIC_ASSERT(offsetof(struct device, delivered) - offsetof(struct device, ring_head) <= UADI_CACHE_LINE,
+                   producer_fields_fit);
+
+static int try_claim(size_t driver_index)
+{
+    int expected = 0;
+    return __atomic_compare_exchange_n(&claimed[driver_index], &expected, 1, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void unclaim(size_t driver_index)
+{
+    __atomic_store_n(&claimed[driver_index], 0, __ATOMIC_RELEASE);
+}
+
+static void counter_add(unsigned long long* counter, unsigned long long value)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value,
+                     __ATOMIC_RELAXED);
+}
+
+static size_t ring_count(struct device* device)
+{
+    size_t tail = __atomic_load_n(&device->ring_tail, __ATOMIC_ACQUIRE);
+    size_t head = __atomic_load_n(&device->ring_head, __ATOMIC_RELAXED);
+    return tail - head;
+}
+
+static uadi_chunk_ptr ring_pop(struct device* device)
+{
+    size_t head = device->ring_head;
+    uadi_chunk_ptr chunk;
+    if(head == device->cached_tail){
+        device->cached_tail = __atomic_load_n(&device->ring_tail, __ATOMIC_ACQUIRE);
+        if(head == device->cached_tail)
+            return NULL;
+    }
+    chunk = device->ring[head & (UADI_FREE_RING_CAPACITY - 1)];
+    __atomic_store_n(&device->ring_head, head + 1, __ATOMIC_RELEASE);
+    return chunk;
+}
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+static void warm_chunks(struct device* device, uadi_chunk_ptr* chunk_array, size_t chunk_count)
+{
+    size_t i;
+    for(i = 0; i < chunk_count; ++i)
+        uadi_prefault(chunk_array[i], device->options.chunk_size);
+    counter_add(&device->chunks_warmed, chunk_count);
+}
+
+static size_t sample_size(int sample_format)
+{
+    return sample_format == UADI_FORMAT_FLOAT32 ? sizeof(float) : sizeof(unsigned short);
+}
+
+/* Copies count samples of a chunk, starting at index, as floats. */
+static void widen_samples(struct device* device, float* out, unsigned char const* chunk,
+                          size_t index, size_t count)
+{
+    switch(device->options.sample_format){
+    case UADI_FORMAT_FLOAT16:
+        uadi_kernels.widen_f16(out, (unsigned short const*)chunk + index, count);
+        break;
+    case UADI_FORMAT_BFLOAT16:
+        uadi_kernels.widen_bf16(out, (unsigned short const*)chunk + index, count);
+        break;
+    default:
+        memcpy(out, (float const*)chunk + index, count * sizeof(float));
+        break;
+    }
+}
+
+/* Copies the newest samples of a filled chunk into the history ring. */
+static void record_history(struct device* device, unsigned char const* chunk, size_t count)
+{
+    size_t capacity = device->history_mask + 1;
+    unsigned long long written = device->history_written;
+    size_t index = 0;
+    size_t begin;
+    size_t first;
+
+    if(count > capacity){
+        index = count - capacity;
+        count = capacity;
+    }
+    __atomic_store_n(&device->history_begun, written + count, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    begin = (size_t)(written & device->history_mask);
+    first = capacity - begin < count ? capacity - begin : count;
+    widen_samples(device, device->history + begin, chunk, index, first);
+    widen_samples(device, device->history, chunk, index + first, count - first);
+
+    __atomic_store_n(&device->history_timestamp, monotonic_ns(), __ATOMIC_RELAXED);
+    __atomic_store_n(&device->history_written, written + count, __ATOMIC_RELEASE);
+}
+
+/* True once the producer has to stop filling: for good, or paused by
+ * uadi_stop until the next start. */
+static int stopping(struct device* device)
+{
+    return !__atomic_load_n(&device->running, __ATOMIC_ACQUIRE)
+        || __atomic_load_n(&device->armed, __ATOMIC_ACQUIRE);
+}
+
+static int has_chunks(struct device* device)
+{
+    return ring_count(device) != 0 || stopping(device);
+}
+
+/* The descriptor for the next chunk is free once the chunk that used it
+ * UADI_DESCRIPTOR_COUNT chunks ago has been consumed. */
+static int descriptor_free(struct device* device)
+{
+    unsigned long long sequence = device->sequence;
+    struct chunk_descriptor* descriptor =
+        &device->descriptors[sequence & (UADI_DESCRIPTOR_COUNT - 1)];
+    return sequence < UADI_DESCRIPTOR_COUNT
+        || __atomic_load_n(&descriptor->consumed, __ATOMIC_ACQUIRE) == sequence - UADI_DESCRIPTOR_COUNT + 1;
+}
+
+static int has_descriptor(struct device* device)
+{
+    return descriptor_free(device) || stopping(device);
+}
+
+/* In a mirrored ring the producer may only write the next chunk if that
+ * keeps the chunks awaiting delivery and the history before the oldest of
+ * them intact. */
+static int mirror_space_free(struct device* device)
+{
+    unsigned long long delivered = __atomic_load_n(&device->delivered, __ATOMIC_ACQUIRE);
+    return (device->sequence - delivered + 1) * device->options.chunk_size
+        + device->options.mirror_history <= device->options.mirror_size;
+}
+
+static int has_mirror_space(struct device* device)
+{
+    return mirror_space_free(device) || stopping(device);
+}
+
+/* Address of the chunk at offset in the mirrored ring. The chunk is placed so
+ * that the history preceding it is contiguous with it as well. */
+static uadi_chunk_ptr mirror_chunk(struct device* device, unsigned long long offset)
+{
+    size_t size = device->options.mirror_size;
+    size_t history = device->options.mirror_history;
+    return device->mirror + (size_t)((offset + size - history) % size) + history;
+}
+
+static void set_producer_state(struct device* device, int state)
+{
+    __atomic_store_n(&device->producer_state, state, __ATOMIC_RELAXED);
+}
+
+/* Polls until ready, or until the deadline has passed. Returns 1 if ready. */
+static int poll_until(struct device* device, int (*ready)(struct device*),
+                      unsigned long long deadline, int yield)
+{
+    unsigned int i;
+    for(;;){
+        for(i = 0; i < 64; ++i){
+            if(ready(device))
+                return 1;
+            if(yield)
+                sched_yield();
+            else
+                uadi_cpu_relax();
+        }
+        if(deadline && monotonic_ns() >= deadline)
+            return 0;
+    }
+}
+
+/* Waits according to the wait strategy of the device until ready, which also
+ * has to become true when the device is stopped. Returns 0 if the device has
+ * been stopped. */
+static int wait_until(struct device* device, int (*ready)(struct device*))
+{
+    struct uadi_device_options const* options = &device->options;
+
+    if(options->wait_strategy == UADI_WAIT_BUSY_POLL){
+        set_producer_state(device, UADI_PRODUCER_SPINNING);
+        poll_until(device, ready, 0, 0);
+    } else if(options->wait_strategy == UADI_WAIT_ADAPTIVE){
+        unsigned long long start = monotonic_ns();
+        set_producer_state(device, UADI_PRODUCER_SPINNING);
+        if(!poll_until(device, ready, start + options->spin_ns, 0)){
+            set_producer_state(device, UADI_PRODUCER_YIELDING);
+            poll_until(device, ready, start + options->yield_ns, 1);
+        }
+    }
+
+    while(!ready(device)){
+        uadi_parker_prepare(&device->parker);
+        if(ready(device)){
+            uadi_parker_cancel(&device->parker);
+            break;
+        }
+        set_producer_state(device, UADI_PRODUCER_PARKED);
+        counter_add(&device->producer_parks, 1);
+        uadi_parker_wait(&device->parker);
+    }
+    set_producer_state(device, UADI_PRODUCER_FILLING);
+    return __atomic_load_n(&device->running, __ATOMIC_ACQUIRE);
+}
+
+/* Index of a chunk of the pool of a device. */
+static size_t pool_index(struct device const* device, uadi_chunk_ptr chunk)
+{
+    return (size_t)(chunk - device->pool) / device->pool_stride;
+}
+
+/* Runs the receive callback for every published chunk that hasn't been
+ * delivered yet, in sequence. Only one thread at a time delivers for a
+ * device: the producer thread itself, or the pool thread that has taken the
+ * scheduled device. */
+static void deliver_chunks(struct device* device)
+{
+    unsigned long long published = __atomic_load_n(&device->sequence, __ATOMIC_ACQUIRE);
+    unsigned long long delivered = device->delivered;
+    struct uadi_receive_struct receive;
+    struct chunk_descriptor* descriptor;
+
+    while(delivered != published){
+        descriptor = &device->descriptors[delivered & (UADI_DESCRIPTOR_COUNT - 1)];
+        receive.infopack_ptr = NULL;
+        receive.datapack_ptr = descriptor->chunk;
+        receive.status = descriptor->status;
+        receive.header = &descriptor->header;
+        if(device->pool)
+            __atomic_store_n(&device->pool_lent[pool_index(device, descriptor->chunk)], 1, __ATOMIC_RELAXED);
+        UADI_TRACE(device->trace[UADI_TRACE_DELIVERY], UADI_TRACE_CALLBACK_BEGIN,
+                   descriptor->chunk, delivered);
+        device->receive_callback(&receive, device->receive_context);
+        UADI_TRACE(device->trace[UADI_TRACE_DELIVERY], UADI_TRACE_CALLBACK_END,
+                   descriptor->chunk, delivered);
+
+        ++delivered;
+        __atomic_store_n(&device->delivered, delivered, __ATOMIC_RELEASE);
+        __atomic_store_n(&descriptor->consumed, delivered, __ATOMIC_RELEASE);
+        if(device->options.delivery == UADI_DELIVERY_POOL){
+            uadi_parker_wake(&device->parker);
+            if(delivered == published)
+                published = __atomic_load_n(&device->sequence, __ATOMIC_ACQUIRE);
+        }
+    }
+}
+
+static void schedule_delivery(struct device* device)
+{
+    struct delivery_pool* pool = &device->connection->pool;
+    int expected = 0;
+
+    if(__atomic_load_n(&device->scheduled, __ATOMIC_SEQ_CST)
+       || !__atomic_compare_exchange_n(&device->scheduled, &expected, 1, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return;
+    pthread_mutex_lock(&pool->lock);
+    device->pool_next = NULL;
+    if(pool->queue_tail)
+        pool->queue_tail->pool_next = device;
+    else
+        pool->queue_head = device;
+    pool->queue_tail = device;
+    pthread_cond_signal(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void* delivery_thread(void* arg)
+{
+    struct delivery_pool* pool = (struct delivery_pool*)arg;
+    struct device* device;
+    int expected;
+
+    pthread_mutex_lock(&pool->lock);
+    for(;;){
+        while(!pool->queue_head && !pool->stop)
+            pthread_cond_wait(&pool->wakeup, &pool->lock);
+        device = pool->queue_head;
+        if(!device)
+            break;
+        pool->queue_head = device->pool_next;
+        if(!pool->queue_head)
+            pool->queue_tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        deliver_chunks(device);
+
+        /* Unscheduling and the check for chunks published meanwhile happen
+         * under the pool lock, so a release waiting for the device to become
+         * unscheduled knows this thread is done with it. */
+        pthread_mutex_lock(&pool->lock);
+        __atomic_store_n(&device->scheduled, 0, __ATOMIC_SEQ_CST);
+        expected = 0;
+        if(__atomic_load_n(&device->sequence, __ATOMIC_SEQ_CST) != device->delivered
+           && __atomic_compare_exchange_n(&device->scheduled, &expected, 1, 0,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)){
+            device->pool_next = NULL;
+            if(pool->queue_tail)
+                pool->queue_tail->pool_next = device;
+            else
+                pool->queue_head = device;
+            pool->queue_tail = device;
+            /* Another device is ahead of it and this thread takes that one. */
+            if(pool->queue_head != device)
+                pthread_cond_signal(&pool->wakeup);
+        } else {
+            pthread_cond_broadcast(&pool->drained);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Blocks until the delivery pool has delivered every published chunk of a
+ * stopped device. */
+static void wait_for_delivery(struct device* device)
+{
+    struct delivery_pool* pool = &device->connection->pool;
+    pthread_mutex_lock(&pool->lock);
+    while(__atomic_load_n(&device->scheduled, __ATOMIC_SEQ_CST))
+        pthread_cond_wait(&pool->drained, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static int start_delivery_pool(struct delivery_pool* pool)
+{
+    while(pool->thread_count < UADI_DELIVERY_THREADS){
+        if(pthread_create(&pool->threads[pool->thread_count], NULL, delivery_thread, pool) != 0)
+            return pool->thread_count ? UADI_SUCCESS : UADI_INTERNAL_ERROR;
+        ++pool->thread_count;
+    }
+    return UADI_SUCCESS;
+}
+
+static void stop_delivery_pool(struct delivery_pool* pool)
+{
+    size_t i;
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+    for(i = 0; i < pool->thread_count; ++i)
+        pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->drained);
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+/* Fills the next chunk and hands it over for delivery. The caller makes sure
+ * a descriptor is free. Returns 0 if there is no chunk to fill. */
+static int fill_next_chunk(struct device* device)
+{
+    struct chunk_descriptor* descriptor;
+    uadi_chunk_ptr chunk;
+    int pipelined;
+
+    if(device->mirror){
+        if(!mirror_space_free(device))
+            return 0;
+        chunk = mirror_chunk(device, device->sequence * device->options.chunk_size);
+    } else {
+        chunk = ring_pop(device);
+        if(!chunk)
+            return 0;
+    }
+    UADI_TRACE(device->trace[UADI_TRACE_PRODUCER], UADI_TRACE_FILL_BEGIN, chunk, device->sequence);
+    descriptor = &device->descriptors[device->sequence & (UADI_DESCRIPTOR_COUNT - 1)];
+    descriptor->chunk = chunk;
+    descriptor->header.sequence = device->sequence;
+    descriptor->header.timestamp_ns = monotonic_ns();
+    descriptor->header.stream_offset = device->stream_offset;
+    descriptor->header.data_size = device->options.chunk_size;
+    descriptor->header.sample_count = (unsigned int)(device->options.chunk_size
+                                                     / sample_size(device->options.sample_format));
+    descriptor->header.sample_format = (unsigned int)device->options.sample_format;
+    descriptor->header.flags = device->mirror ? UADI_CHUNK_MIRRORED
+                             : device->pool ? UADI_CHUNK_POOLED : 0u;
+    /* The pipeline reads the chunk right back, it has to stay in the cache. */
+    pipelined = __atomic_load_n(&device->pipeline, __ATOMIC_ACQUIRE) != NULL;
+    descriptor->status = device->driver->fill_chunk(device->driver_state, chunk,
+                                                    device->options.chunk_size,
+                                                    device->non_temporal && !(pipelined
+                                                        && device->options.fill_mode == UADI_FILL_AUTO),
+                                                    &descriptor->header);
+    if(pipelined && descriptor->status == UADI_SUCCESS){
+        pthread_mutex_lock(&device->pipeline_lock);
+        if(device->pipeline)
+            uadi_pipeline_run(device->pipeline, (float*)chunk, &descriptor->header);
+        pthread_mutex_unlock(&device->pipeline_lock);
+    }
+    if(device->options.checksum && descriptor->status == UADI_SUCCESS){
+        descriptor->header.checksum = uadi_kernels.crc32c(0, chunk, descriptor->header.data_size);
+        descriptor->header.flags |= UADI_CHUNK_CHECKSUM;
+    }
+    if(device->history)
+        record_history(device, chunk, descriptor->header.sample_count);
+    if(device->recorder)
+        uadi_recorder_record(device->recorder, &descriptor->header, chunk);
+    UADI_TRACE(device->trace[UADI_TRACE_PRODUCER], UADI_TRACE_FILL_END, chunk, device->sequence);
+    /* A pipeline may have shrunk the datapack, the next one follows on. */
+    device->stream_offset += descriptor->header.data_size;
+
+    if(device->options.delivery == UADI_DELIVERY_POOL){
+        __atomic_store_n(&device->sequence, device->sequence + 1, __ATOMIC_SEQ_CST);
+        schedule_delivery(device);
+    } else {
+        __atomic_store_n(&device->sequence, device->sequence + 1, __ATOMIC_RELEASE);
+        deliver_chunks(device);
+    }
+    return 1;
+}
+
+static int is_started(struct device* device)
+{
+    return !__atomic_load_n(&device->armed, __ATOMIC_ACQUIRE)
+        || !__atomic_load_n(&device->running, __ATOMIC_ACQUIRE);
+}
+
+/* Waits for uadi_start_group and then for its deadline. Returns 0 if the
+ * device has been stopped for good meanwhile. A uadi_stop during the lead
+ * time ends the wait early, the caller then finds the device armed again. */
+static int wait_for_start(struct device* device)
+{
+    unsigned long long now;
+    struct timespec pause;
+
+    /* An armed device may wait for a long time, it always parks. The state
+     * tells uadi_stop that the producer is done with the chunks it filled. */
+    while(!is_started(device)){
+        __atomic_store_n(&device->producer_state, UADI_PRODUCER_ARMED, __ATOMIC_RELEASE);
+        uadi_parker_prepare(&device->parker);
+        if(is_started(device)){
+            uadi_parker_cancel(&device->parker);
+            break;
+        }
+        uadi_parker_wait(&device->parker);
+    }
+    while((now = monotonic_ns()) + UADI_START_SPIN_NS < device->start_ns && !stopping(device)){
+        now = device->start_ns - now - UADI_START_SPIN_NS;
+        if(now > UADI_START_SLEEP_NS)
+            now = UADI_START_SLEEP_NS;
+        pause.tv_sec = 0;
+        pause.tv_nsec = (long)now;
+        nanosleep(&pause, NULL);
+    }
+    while(monotonic_ns() < device->start_ns && !stopping(device))
+        sched_yield();
+    set_producer_state(device, UADI_PRODUCER_FILLING);
+    return __atomic_load_n(&device->running, __ATOMIC_ACQUIRE);
+}
+
+static void* device_thread(void* arg)
+{
+    struct device* device = (struct device*)arg;
+
+    while(__atomic_load_n(&device->running, __ATOMIC_ACQUIRE)){
+        if(__atomic_load_n(&device->armed, __ATOMIC_ACQUIRE)){
+            if(!wait_for_start(device))
+                break;
+            continue;
+        }
+        if(!descriptor_free(device)){
+            counter_add(&device->producer_stalls, 1);
+            if(!wait_until(device, has_descriptor))
+                break;
+            continue;
+        }
+        if(!fill_next_chunk(device)){
+            counter_add(&device->producer_waits, 1);
+            if(!wait_until(device, device->mirror ? has_mirror_space : has_chunks))
+                break;
+        }
+    }
+    return NULL;
+}
+
+static unsigned long long pacer_tick(struct pacer const* pacer, unsigned long long ns)
+{
+    return ns > pacer->origin_ns ? (ns - pacer->origin_ns) / UADI_PACER_TICK_NS : 0;
+}
+
+static struct device* timer_device(struct uadi_timer* timer)
+{
+    return (struct device*)((char*)timer - offsetof(struct device, timer));
+}
+
+/* Puts a paced device into the wheel, for the tick its next chunk is due in. */
+static void schedule_paced(struct pacer* pacer, struct device* device)
+{
+    device->timer.expiry = pacer_tick(pacer, device->due_ns + UADI_PACER_TICK_NS - 1);
+    uadi_wheel_add(&pacer->wheel, &device->timer);
+    device->pacing = PACING_SCHEDULED;
+}
+
+/* Runs on the pacer thread when a paced device is due. */
+static void pace_device(struct device* device, unsigned long long now)
+{
+    int filled = 0;
+
+    /* Periods shorter than a tick take several chunks per expiry. A chunk
+     * that can't be filled stays due and is retried with the next tick. */
+    do{
+        if(!descriptor_free(device) || !fill_next_chunk(device)){
+            counter_add(&device->producer_waits, 1);
+            break;
+        }
+        device->due_ns += device->period_ns;
+    }while(device->due_ns <= now && ++filled < UADI_PACER_BATCH);
+
+    /* A device that fell behind by more than a period drops the backlog
+     * instead of bursting to catch up. */
+    if(device->due_ns + device->period_ns < now)
+        device->due_ns = now;
+    set_producer_state(device, UADI_PRODUCER_PACED);
+}
+
+static void pacer_sleep_until(struct pacer* pacer, unsigned long long deadline_ns)
+{
+    struct timespec deadline;
+#ifndef __linux__
+    /* Without pthread_condattr_setclock the condition uses the realtime clock. */
+    unsigned long long now = monotonic_ns();
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline_ns = (unsigned long long)deadline.tv_sec * 1000000000ull + (unsigned long long)deadline.tv_nsec
+        + (deadline_ns > now ? deadline_ns - now : 0);
+#endif
+    deadline.tv_sec = (time_t)(deadline_ns / 1000000000ull);
+    deadline.tv_nsec = (long)(deadline_ns % 1000000000ull);
+    pthread_cond_timedwait(&pacer->wakeup, &pacer->lock, &deadline);
+}
+
+static void* pacer_thread(void* arg)
+{
+    struct pacer* pacer = (struct pacer*)arg;
+    struct uadi_timer* expired;
+    struct uadi_timer* timer;
+    struct uadi_timer* next;
+    struct device* device;
+    unsigned long long now;
+    unsigned long long tick;
+
+    pthread_mutex_lock(&pacer->lock);
+    while(!pacer->stop){
+        now = monotonic_ns();
+        expired = uadi_wheel_advance(&pacer->wheel, pacer_tick(pacer, now));
+        if(!expired){
+            tick = uadi_wheel_next_expiry(&pacer->wheel);
+            if(tick == UADI_WHEEL_NEVER)
+                pthread_cond_wait(&pacer->wakeup, &pacer->lock);
+            else
+                pacer_sleep_until(pacer, pacer->origin_ns + tick * UADI_PACER_TICK_NS);
+            continue;
+        }
+
+        for(timer = expired; timer; timer = timer->next)
+            timer_device(timer)->pacing = PACING_RUNNING;
+        pthread_mutex_unlock(&pacer->lock);
+        for(timer = expired; timer; timer = timer->next)
+            pace_device(timer_device(timer), now);
+        pthread_mutex_lock(&pacer->lock);
+
+        for(timer = expired; timer; timer = next){
+            next = timer->next;
+            device = timer_device(timer);
+            /* A device stopped meanwhile, for good or by uadi_stop, leaves
+             * the wheel; remove_paced_device may be waiting either way. */
+            if(stopping(device))
+                device->pacing = PACING_OFF;
+            else
+                schedule_paced(pacer, device);
+        }
+        pthread_cond_broadcast(&pacer->idle);
+    }
+    pthread_mutex_unlock(&pacer->lock);
+    return NULL;
+}
+
+static void init_pacer(struct pacer* pacer)
+{
+    pthread_condattr_t attributes;
+    pthread_mutex_init(&pacer->lock, NULL);
+    pthread_condattr_init(&attributes);
+#ifdef __linux__
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&pacer->wakeup, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_cond_init(&pacer->idle, NULL);
+}
+
+static int start_pacer(struct pacer* pacer)
+{
+    if(pacer->started)
+        return UADI_SUCCESS;
+    pacer->origin_ns = monotonic_ns();
+    uadi_wheel_init(&pacer->wheel, 0);
+    if(pthread_create(&pacer->thread, NULL, pacer_thread, pacer) != 0)
+        return UADI_INTERNAL_ERROR;
+    pacer->started = 1;
+    return UADI_SUCCESS;
+}
+
+static void stop_pacer(struct pacer* pacer)
+{
+    if(pacer->started){
+        pthread_mutex_lock(&pacer->lock);
+        pacer->stop = 1;
+        pthread_cond_signal(&pacer->wakeup);
+        pthread_mutex_unlock(&pacer->lock);
+        pthread_join(pacer->thread, NULL);
+    }
+    pthread_cond_destroy(&pacer->idle);
+    pthread_cond_destroy(&pacer->wakeup);
+    pthread_mutex_destroy(&pacer->lock);
+}
+
+/* Starts pacing a device, its first chunk is due one period after start_ns. */
+static void add_paced_device(struct pacer* pacer, struct device* device, unsigned long long start_ns)
+{
+    pthread_mutex_lock(&pacer->lock);
+    /* The pacer doesn't advance an empty wheel while it waits, which would
+     * otherwise walk every tick since then once this device is added. An
+     * empty wheel skips to the current tick at once. */
+    if(!pacer->wheel.count)
+        uadi_wheel_advance(&pacer->wheel, pacer_tick(pacer, monotonic_ns()));
+    device->due_ns = start_ns + device->period_ns;
+    set_producer_state(device, UADI_PRODUCER_PACED);
+    schedule_paced(pacer, device);
+    pthread_cond_signal(&pacer->wakeup);
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+/* Takes a stopped paced device out of the wheel, waiting for the pacer thread
+ * if it is filling a chunk of the device right now. */
+static void remove_paced_device(struct pacer* pacer, struct device* device)
+{
+    pthread_mutex_lock(&pacer->lock);
+    while(device->pacing == PACING_RUNNING)
+        pthread_cond_wait(&pacer->idle, &pacer->lock);
+    if(device->pacing == PACING_SCHEDULED)
+        uadi_wheel_remove(&pacer->wheel, &device->timer);
+    device->pacing = PACING_OFF;
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+static void return_unused_chunk(struct device* device, uadi_chunk_ptr chunk)
+{
+    struct uadi_receive_struct receive;
+    counter_add(&device->chunks_returned, 1);
+    if(device->recycle_callback){
+        device->recycle_callback(chunk, device->options.chunk_size, device->recycle_context);
+        return;
+    }
+    chunk[0] = '\0';
+    receive.infopack_ptr = chunk;
+    receive.datapack_ptr = NULL;
+    receive.status = UADI_SUCCESS;
+    receive.header = NULL;
+    device->receive_callback(&receive, device->receive_context);
+}
+
+static void close_driver(struct device* device)
+{
+    if(device->driver_opened && device->driver->close)
+        device->driver->close(device->driver_state);
+    device->driver_opened = 0;
+}
+
+static void stop_device(struct device* device)
+{
+    uadi_chunk_ptr chunk;
+
+    __atomic_store_n(&device->running, 0, __ATOMIC_SEQ_CST);
+    if(device->period_ns){
+        remove_paced_device(&device->connection->pacer, device);
+    } else {
+        uadi_parker_wake(&device->parker);
+        pthread_join(device->thread, NULL);
+    }
+    set_producer_state(device, UADI_PRODUCER_STOPPED);
+    if(device->options.delivery == UADI_DELIVERY_POOL)
+        wait_for_delivery(device);
+
+    /* Chunks of a pool belong to the library and are freed with it. */
+    while(!device->pool && (chunk = ring_pop(device)) != NULL){
+        UADI_TRACE(device->trace[UADI_TRACE_PRODUCER], UADI_TRACE_RETURN,
+                   chunk, device->chunks_returned);
+        return_unused_chunk(device, chunk);
+    }
+
+    close_driver(device);
+    unclaim(device->driver_index);
+
+    uadi_parker_destroy(&device->parker);
+}
+
+static void add_device_statistics(struct device* device, struct uadi_statistics* stats)
+{
+    stats->chunks_pushed += __atomic_load_n(&device->chunks_pushed, __ATOMIC_RELAXED);
+    stats->pushes_rejected += __atomic_load_n(&device->pushes_rejected, __ATOMIC_RELAXED);
+    stats->chunks_delivered += __atomic_load_n(&device->delivered, __ATOMIC_RELAXED);
+    stats->chunks_returned += __atomic_load_n(&device->chunks_returned, __ATOMIC_RELAXED);
+    stats->producer_waits += __atomic_load_n(&device->producer_waits, __ATOMIC_RELAXED);
+    stats->chunks_warmed += __atomic_load_n(&device->chunks_warmed, __ATOMIC_RELAXED);
+    stats->producer_parks += __atomic_load_n(&device->producer_parks, __ATOMIC_RELAXED);
+    stats->producer_stalls += __atomic_load_n(&device->producer_stalls, __ATOMIC_RELAXED);
+    stats->chunks_awaiting_delivery += __atomic_load_n(&device->sequence, __ATOMIC_RELAXED)
+        - __atomic_load_n(&device->delivered, __ATOMIC_RELAXED);
+    stats->chunks_queued += ring_count(device);
+    if(device->recorder){
+        stats->recordings_written += uadi_recorder_dumps_written(device->recorder);
+        stats->recordings_failed += uadi_recorder_dumps_failed(device->recorder);
+    }
+}
+
+static void free_device(struct device* device)
+{
+    size_t i;
+    close_driver(device);
+    for(i = 0; i < UADI_TRACE_WRITERS; ++i)
+        uadi_trace_ring_destroy(device->trace[i]);
+    uadi_mirror_unmap(device->mirror, device->options.mirror_size);
+    uadi_pool_unmap(device->pool, device->pool_size);
+    free(device->pool_lent);
+    uadi_aligned_free(device->history);
+    uadi_recorder_destroy(device->recorder);
+    uadi_pipeline_destroy(device->pipeline);
+    pthread_mutex_destroy(&device->pipeline_lock);
+    uadi_aligned_free(device);
+}
+
+/* Stops the device and folds its counters into the connection totals. The
+ * device must already be unlinked from the connection. */
+static void retire_device(struct device* device)
+{
+    struct connection* connection = device->connection;
+    stop_device(device);
+    pthread_mutex_lock(&connection->lock);
+    add_device_statistics(device, &connection->released);
+    pthread_mutex_unlock(&connection->lock);
+    free_device(device);
+}
+
+static void copy_statistics(struct uadi_statistics const* stats,
+                            struct uadi_statistics* out, size_t out_size)
+{
+    memcpy(out, stats, out_size < sizeof(*stats) ? out_size : sizeof(*stats));
+}
+
 uadi_status uadi_init(uadi_lib_handle* lib_handle)
 {
-    //spawns a new thread for the connection
-    return 0;
-};
+    struct connection* connection;
+    if(!lib_handle)
+        return UADI_INVALID_HANDLE;
+    uadi_kernels_init();
+    connection = (struct connection*)calloc(1, sizeof(*connection));
+    if(!connection)
+        return UADI_INTERNAL_ERROR;
+    pthread_mutex_init(&connection->lock, NULL);
+    pthread_mutex_init(&connection->pool.lock, NULL);
+    pthread_cond_init(&connection->pool.wakeup, NULL);
+    pthread_cond_init(&connection->pool.drained, NULL);
+    init_pacer(&connection->pacer);
+    uadi_trace_clock_sample(&connection->trace_origin);
+    *lib_handle = connection;
+    return UADI_SUCCESS;
+}
 
 uadi_status uadi_get_meta_data(
-    uadi_lib_handle lib_handle, 
-    uadi_chunk_ptr meta_data)
-{
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "name", "iota-producer");
-    cJSON_AddNumberToObject(root, "version", "0.0.1");
-    cJSON_AddStringToObject(root, "author", "...");
-    cJSON_AddStringToObject(root, "description", "...");
-
-    char* jsonStr = cJSON_Print(root);
-    memcpy(meta_data, jsonStr, strlen(jsonStr) + 1);
-    cJSON_Delete(root);
-    free(jsonStr);
-    return 0;
-};
+    uadi_lib_handle lib_handle,
+    char* meta_data,
+    size_t meta_data_size)
+{
+    int length;
+    if(!lib_handle)
+        return UADI_INVALID_HANDLE;
+    length = snprintf(meta_data, meta_data_size,
+        "{\"name\":\"iota-producer\","
+        "\"version\":\"" UADI_VERSION "\","
+        "\"author\":\"skunkforce e.V.\","
+        "\"description\":\"generates a sawtooth of floats from 0 to 255\","
+        "\"chunk_size\":%d,"
+        "\"isa\":\"%s\"}",
+        UADI_DEFAULT_CHUNK_SIZE,
+        uadi_isa_name(uadi_kernels.isa));
+    if(length < 0)
+        return UADI_INTERNAL_ERROR;
+    if((size_t)length >= meta_data_size)
+        return UADI_BUFFER_TOO_SMALL;
+    return UADI_SUCCESS;
+}
 
-uadi_status uadi_enumerate(uadi_lib_handle handle, uadi_chunk_ptr device_list)
+uadi_status uadi_enumerate(
+    uadi_lib_handle handle,
+    char* device_list,
+    size_t device_list_size)
 {
-    const char* jsonStr = 
-        "{\"devices\":["
-        "{\"key\":\"123e4567-e89b-12d3-a456-426655440000\",\"vendor\":\"skunkforce e.V.\",\"description\":\"generates an iota\"},"
-        "{\"key\":\"e89b4567-123e-12d3-a456-426655440000\",\"vendor\":\"skunkforce e.V.\",\"description\":\"generates an inverse iota\"}"
-        "]}";
+    size_t length = 0;
+    size_t i;
+    int written;
 
-    memcpy(device_list, jsonStr, strlen(jsonStr) + 1);
-    return 0;
-};
+    if(!handle)
+        return UADI_INVALID_HANDLE;
+    /* snprintf still counts once the buffer is full, so a too small buffer
+     * is detected after the last driver. */
+    for(i = 0; i <= DRIVER_COUNT + 1; ++i){
+        size_t left = length < device_list_size ? device_list_size - length : 0;
+        char* out = left ? device_list + length : NULL;
+        if(i == 0)
+            written = snprintf(out, left, "{\"devices\":[");
+        else if(i <= DRIVER_COUNT)
+            written = snprintf(out, left, "%s{\"key\":\"%s\",\"vendor\":\"%s\",\"description\":\"%s\"}",
+                               i > 1 ? "," : "", drivers[i - 1]->key,
+                               drivers[i - 1]->vendor, drivers[i - 1]->description);
+        else
+            written = snprintf(out, left, "]}");
+        if(written < 0)
+            return UADI_INTERNAL_ERROR;
+        length += (size_t)written;
+    }
+    if(length >= device_list_size)
+        return UADI_BUFFER_TOO_SMALL;
+    return UADI_SUCCESS;
+}
 
-DLL_EXPORT uadi_status uadi_claim_device(
-    uadi_lib_handle lib_handle, 
-    uadi_device_handle* device_handle, 
-    char const* device_key, 
-    uadi_receive_callback callback, 
-    void* user_data)
+uadi_status uadi_get_capabilities(
+    uadi_lib_handle lib_handle,
+    struct uadi_capabilities* caps,
+    size_t caps_size)
 {
+    struct uadi_capabilities capabilities;
 
-    return 0;
-};
+    if(!lib_handle || !caps)
+        return UADI_INVALID_HANDLE;
+    memset(&capabilities, 0, sizeof(capabilities));
+    capabilities.api_version = UADI_API_VERSION;
+    capabilities.device_count = (unsigned int)DRIVER_COUNT;
+    capabilities.features = UADI_FEATURE_NON_TEMPORAL | UADI_FEATURE_BUSY_POLL
+        | UADI_FEATURE_DELIVERY_POOL | UADI_FEATURE_TRACE | UADI_FEATURE_LATEST_SAMPLES
+        | UADI_FEATURE_RECORDER | UADI_FEATURE_PACING | UADI_FEATURE_CHUNK_POOL
+        | UADI_FEATURE_START_STOP | UADI_FEATURE_ARROW | UADI_FEATURE_FLOAT16
+        | UADI_FEATURE_BFLOAT16 | UADI_FEATURE_CHECKSUM | UADI_FEATURE_PIPELINE
+        | UADI_FEATURE_EXPRESSION;
+#ifdef __linux__
+    capabilities.features |= UADI_FEATURE_MIRROR | UADI_FEATURE_HUGE_PAGES;
+#endif
+    capabilities.chunk_size_min = sizeof(float);
+    capabilities.chunk_size_max = (size_t)-1 / sizeof(float) * sizeof(float);
+    capabilities.chunk_size_multiple = sizeof(float);
+    capabilities.default_chunk_size = UADI_DEFAULT_CHUNK_SIZE;
+    capabilities.chunk_alignment = sizeof(float);
+    capabilities.preferred_chunk_alignment = UADI_CACHE_LINE;
+    capabilities.max_chunks = UADI_FREE_RING_CAPACITY;
+    memcpy(caps, &capabilities, caps_size < sizeof(capabilities) ? caps_size : sizeof(capabilities));
+    return UADI_SUCCESS;
+}
+
+void uadi_device_options_init(struct uadi_device_options* options)
+{
+    if(!options)
+        return;
+    memset(options, 0, sizeof(*options));
+    options->size = sizeof(*options);
+    options->warmup = UADI_WARMUP_NONE;
+    options->chunk_size = UADI_DEFAULT_CHUNK_SIZE;
+    options->fill_mode = UADI_FILL_AUTO;
+    options->wait_strategy = UADI_WAIT_PARK;
+    options->spin_ns = 20 * 1000;
+    options->yield_ns = 200 * 1000;
+    options->delivery = UADI_DELIVERY_INLINE;
+    options->trace_events = 0;
+    options->mirror_size = 0;
+    options->mirror_history = 0;
+    options->latest_samples = 0;
+    options->recorder_chunks = 0;
+    options->sample_rate = 0;
+    options->pool_chunks = 0;
+    options->pool_huge_pages = 0;
+    options->start_armed = 0;
+    options->sample_format = UADI_FORMAT_FLOAT32;
+    options->checksum = 0;
+}
+
+/* Maps the chunk pool of a device, every chunk aligned as its driver wants. */
+static uadi_status map_pool(struct device* device)
+{
+    size_t alignment = device->driver->chunk_alignment ? device->driver->chunk_alignment
+                                                       : UADI_CACHE_LINE;
+    size_t granule = device->options.pool_huge_pages ? UADI_HUGE_PAGE_SIZE : uadi_page_size();
+
+    if((alignment & (alignment - 1)) || alignment > uadi_page_size())
+        return UADI_NOT_SUPPORTED;
+    device->pool_stride = (device->options.chunk_size + alignment - 1) & ~(alignment - 1);
+    device->pool_size = (device->options.pool_chunks * device->pool_stride + granule - 1)
+        / granule * granule;
+    device->pool = (unsigned char*)uadi_pool_map(device->pool_size, device->options.pool_huge_pages);
+    device->pool_lent = (unsigned char*)calloc(device->options.pool_chunks, 1);
+    if(!device->pool || !device->pool_lent)
+        return UADI_INTERNAL_ERROR;
+    if(device->options.warmup != UADI_WARMUP_NONE)
+        uadi_prefault(device->pool, device->pool_size);
+    return UADI_SUCCESS;
+}
+
+static int valid_options(struct uadi_device_options const* options)
+{
+    return options->sample_format >= UADI_FORMAT_FLOAT32
+        && options->sample_format <= UADI_FORMAT_BFLOAT16
+        && options->chunk_size >= sample_size(options->sample_format)
+        && options->chunk_size % sample_size(options->sample_format) == 0
+        && options->fill_mode >= UADI_FILL_AUTO
+        && options->fill_mode <= UADI_FILL_NON_TEMPORAL
+        && options->wait_strategy >= UADI_WAIT_PARK
+        && options->wait_strategy <= UADI_WAIT_BUSY_POLL
+        && (options->delivery == UADI_DELIVERY_INLINE
+            || options->delivery == UADI_DELIVERY_POOL)
+        && (!options->mirror_size
+            || (options->mirror_history <= options->mirror_size
+                && options->chunk_size <= options->mirror_size - options->mirror_history))
+        && options->pool_chunks <= UADI_FREE_RING_CAPACITY
+        && !(options->pool_chunks && options->mirror_size);
+}
+
+uadi_status uadi_claim_device(
+    uadi_lib_handle lib_handle,
+    uadi_device_handle* device_handle,
+    char const* device_key,
+    uadi_receive_callback receive_callback,
+    void* receive_context,
+    uadi_recycle_unused_chunk_callback recycle_callback,
+    void* recycle_context,
+    uadi_chunk_ptr* chunk_array,
+    size_t chunk_count)
+{
+    return uadi_claim_device_ex(lib_handle, device_handle, device_key,
+                                receive_callback, receive_context,
+                                recycle_callback, recycle_context,
+                                chunk_array, chunk_count, NULL);
+}
+
+uadi_status uadi_claim_device_ex(
+    uadi_lib_handle lib_handle,
+    uadi_device_handle* device_handle,
+    char const* device_key,
+    uadi_receive_callback receive_callback,
+    void* receive_context,
+    uadi_recycle_unused_chunk_callback recycle_callback,
+    void* recycle_context,
+    uadi_chunk_ptr* chunk_array,
+    size_t chunk_count,
+    struct uadi_device_options const* options)
+{
+    struct connection* connection = (struct connection*)lib_handle;
+    struct device* device;
+    size_t driver_index;
+    size_t i;
+
+    if(!connection || !device_handle || !device_key || !receive_callback)
+        return UADI_INVALID_HANDLE;
+    if(chunk_count > UADI_FREE_RING_CAPACITY)
+        return UADI_BUFFER_TOO_SMALL;
+    if(options && options->size < sizeof(size_t))
+        return UADI_ERROR;
+
+    for(driver_index = 0; driver_index < DRIVER_COUNT; ++driver_index)
+        if(strcmp(drivers[driver_index]->key, device_key) == 0)
+            break;
+    if(driver_index == DRIVER_COUNT)
+        return UADI_ERROR;
+
+    if(!try_claim(driver_index))
+        return UADI_ERROR;
+
+    device = (struct device*)uadi_aligned_calloc(UADI_CACHE_LINE, sizeof(*device));
+    if(!device){
+        unclaim(driver_index);
+        return UADI_INTERNAL_ERROR;
+    }
+    pthread_mutex_init(&device->pipeline_lock, NULL);
+    device->connection = connection;
+    device->driver = drivers[driver_index];
+    device->driver_index = driver_index;
+    device->receive_callback = receive_callback;
+    device->receive_context = receive_context;
+    device->recycle_callback = recycle_callback;
+    device->recycle_context = recycle_context;
+    uadi_device_options_init(&device->options);
+    if(options)
+        memcpy(&device->options, options,
+               options->size < sizeof(*options) ? options->size : sizeof(*options));
+    device->options.size = sizeof(device->options);
+    if(device->options.mirror_size){
+        size_t page_size = uadi_page_size();
+        device->options.mirror_size = (device->options.mirror_size + page_size - 1)
+            / page_size * page_size;
+    }
+    if(!valid_options(&device->options)
+       || ((device->options.mirror_size || device->options.pool_chunks) && chunk_count)){
+        free_device(device);
+        unclaim(driver_index);
+        return UADI_ERROR;
+    }
+    if(device->options.sample_format != UADI_FORMAT_FLOAT32
+       && !(device->driver->sample_formats & (1u << device->options.sample_format))){
+        free_device(device);
+        unclaim(driver_index);
+        return UADI_NOT_SUPPORTED;
+    }
+    device->non_temporal = device->options.fill_mode == UADI_FILL_NON_TEMPORAL
+        || (device->options.fill_mode == UADI_FILL_AUTO && !device->options.checksum
+            && device->options.chunk_size >= UADI_NON_TEMPORAL_THRESHOLD);
+    if(device->options.sample_rate){
+        device->period_ns = (unsigned long long)((double)device->options.chunk_size
+                                                 / sample_size(device->options.sample_format)
+                                                 * 1e9 / (double)device->options.sample_rate);
+        if(!device->period_ns)
+            device->period_ns = 1;
+    }
+    if(device->options.delivery == UADI_DELIVERY_POOL || device->period_ns){
+        uadi_status status = UADI_SUCCESS;
+        pthread_mutex_lock(&connection->lock);
+        if(device->options.delivery == UADI_DELIVERY_POOL)
+            status = start_delivery_pool(&connection->pool);
+        if(status == UADI_SUCCESS && device->period_ns)
+            status = start_pacer(&connection->pacer);
+        pthread_mutex_unlock(&connection->lock);
+        if(status != UADI_SUCCESS){
+            free_device(device);
+            unclaim(driver_index);
+            return status;
+        }
+    }
+    if(device->options.mirror_size){
+        device->mirror = (unsigned char*)uadi_mirror_map(device->options.mirror_size);
+        if(!device->mirror){
+            free_device(device);
+            unclaim(driver_index);
+            return UADI_NOT_SUPPORTED;
+        }
+        if(device->options.warmup != UADI_WARMUP_NONE)
+            uadi_prefault(device->mirror, device->options.mirror_size);
+    }
+    if(device->options.pool_chunks){
+        uadi_status status = map_pool(device);
+        if(status != UADI_SUCCESS){
+            free_device(device);
+            unclaim(driver_index);
+            return status;
+        }
+    }
+    if(device->options.recorder_chunks){
+        device->recorder = uadi_recorder_create(device->options.recorder_chunks,
+                                                device->options.chunk_size);
+        if(!device->recorder){
+            free_device(device);
+            unclaim(driver_index);
+            return UADI_INTERNAL_ERROR;
+        }
+    }
+    if(device->options.latest_samples){
+        size_t capacity = 1;
+        while(capacity < device->options.latest_samples)
+            capacity <<= 1;
+        device->history = (float*)uadi_aligned_calloc(UADI_CACHE_LINE, capacity * sizeof(float));
+        if(!device->history){
+            free_device(device);
+            unclaim(driver_index);
+            return UADI_INTERNAL_ERROR;
+        }
+        device->history_mask = capacity - 1;
+    }
+    if(device->options.trace_events){
+        for(i = 0; i < UADI_TRACE_WRITERS; ++i){
+            device->trace[i] = uadi_trace_ring_create(device->options.trace_events);
+            if(!device->trace[i]){
+                free_device(device);
+                unclaim(driver_index);
+                return UADI_INTERNAL_ERROR;
+            }
+        }
+    }
+    if(device->driver->open){
+        uadi_status status = device->driver->open(&device->options, &device->driver_state);
+        if(status != UADI_SUCCESS){
+            free_device(device);
+            unclaim(driver_index);
+            return status;
+        }
+    }
+    device->driver_opened = 1;
+    if(device->options.warmup != UADI_WARMUP_NONE)
+        warm_chunks(device, chunk_array, chunk_count);
+    for(i = 0; i < chunk_count; ++i){
+        device->ring[i] = chunk_array[i];
+        UADI_TRACE(device->trace[UADI_TRACE_CONSUMER], UADI_TRACE_PUSH, chunk_array[i], i);
+    }
+    for(i = 0; i < device->options.pool_chunks; ++i){
+        device->ring[i] = device->pool + i * device->pool_stride;
+        UADI_TRACE(device->trace[UADI_TRACE_CONSUMER], UADI_TRACE_PUSH, device->ring[i], i);
+    }
+    device->ring_tail = chunk_count + device->options.pool_chunks;
+    device->running = 1;
+    if(device->options.start_armed){
+        device->armed = ARMED;
+        set_producer_state(device, UADI_PRODUCER_ARMED);
+    }
+    uadi_parker_init(&device->parker);
+
+    /* The receive callback may fire before this function returns, so the
+     * consumer's handle has to be valid before the thread starts. */
+    *device_handle = device;
+    if(device->period_ns){
+        if(!device->armed)
+            add_paced_device(&connection->pacer, device, monotonic_ns());
+    } else if(pthread_create(&device->thread, NULL, device_thread, device) != 0){
+        *device_handle = NULL;
+        uadi_parker_destroy(&device->parker);
+        free_device(device);
+        unclaim(driver_index);
+        return UADI_INTERNAL_ERROR;
+    }
+
+    pthread_mutex_lock(&connection->lock);
+    device->next = connection->devices;
+    connection->devices = device;
+    pthread_mutex_unlock(&connection->lock);
+    return UADI_SUCCESS;
+}
+
+/* Appends chunks to the free ring and wakes the producer, all or nothing. */
+static uadi_status queue_chunks(struct device* device, uadi_chunk_ptr* chunk_array,
+                                size_t chunk_count)
+{
+    size_t tail = device->ring_tail;
+    size_t i;
+
+    if(chunk_count > UADI_FREE_RING_CAPACITY - (tail - device->cached_head)){
+        device->cached_head = __atomic_load_n(&device->ring_head, __ATOMIC_ACQUIRE);
+        if(chunk_count > UADI_FREE_RING_CAPACITY - (tail - device->cached_head)){
+            counter_add(&device->pushes_rejected, 1);
+            return UADI_BUFFER_TOO_SMALL;
+        }
+    }
+    if(device->options.warmup == UADI_WARMUP_ALWAYS && !device->pool)
+        warm_chunks(device, chunk_array, chunk_count);
+
+    for(i = 0; i < chunk_count; ++i){
+        device->ring[(tail + i) & (UADI_FREE_RING_CAPACITY - 1)] = chunk_array[i];
+        UADI_TRACE(device->trace[UADI_TRACE_CONSUMER], UADI_TRACE_PUSH,
+                   chunk_array[i], device->chunks_pushed + i);
+    }
+    __atomic_store_n(&device->ring_tail, tail + chunk_count, __ATOMIC_SEQ_CST);
+    counter_add(&device->chunks_pushed, chunk_count);
+
+    uadi_parker_wake(&device->parker);
+    return UADI_SUCCESS;
+}
 
 uadi_status uadi_push_chunks(
-    uadi_device_handle device_handle, 
-    uadi_chunk_ptr* chunk_array, 
+    uadi_device_handle device_handle,
+    uadi_chunk_ptr* chunk_array,
     size_t chunk_count)
 {
-    return 0;
-};
+    struct device* device = (struct device*)device_handle;
+
+    if(!device)
+        return UADI_INVALID_HANDLE;
+    if(device->mirror || device->pool)
+        return UADI_NOT_SUPPORTED;
+    return queue_chunks(device, chunk_array, chunk_count);
+}
+
+uadi_status uadi_release_chunks(
+    uadi_device_handle device_handle,
+    uadi_chunk_ptr* chunk_array,
+    size_t chunk_count)
+{
+    struct device* device = (struct device*)device_handle;
+    uadi_status status;
+    size_t offset;
+    size_t i;
+
+    if(!device)
+        return UADI_INVALID_HANDLE;
+    if(!device->pool)
+        return UADI_NOT_SUPPORTED;
+    /* A chunk released twice would be filled for two datapacks at once, so
+     * only lent chunks are taken back, each once even within one array. */
+    for(i = 0; i < chunk_count; ++i){
+        if(chunk_array[i] < device->pool)
+            break;
+        offset = (size_t)(chunk_array[i] - device->pool);
+        if(offset % device->pool_stride
+           || offset / device->pool_stride >= device->options.pool_chunks
+           || !__atomic_exchange_n(&device->pool_lent[offset / device->pool_stride], 0, __ATOMIC_RELAXED))
+            break;
+    }
+    status = i == chunk_count ? queue_chunks(device, chunk_array, chunk_count) : UADI_ERROR;
+    if(status != UADI_SUCCESS)
+        while(i--)
+            __atomic_store_n(&device->pool_lent[pool_index(device, chunk_array[i])], 1, __ATOMIC_RELAXED);
+    return status;
+}
+
+uadi_status uadi_start_group(
+    uadi_device_handle* device_handles,
+    size_t device_count,
+    unsigned long long lead_ns)
+{
+    struct device* device;
+    unsigned long long start_ns;
+    int expected;
+    size_t i;
+
+    if(!device_handles)
+        return UADI_INVALID_HANDLE;
+    /* Every device is marked as being started, still armed for everyone
+     * else, so a device listed twice is found not to be armed the second
+     * time. Pacing it twice would link its timer into the wheel twice. */
+    for(i = 0; i < device_count; ++i){
+        expected = ARMED;
+        device = (struct device*)device_handles[i];
+        if(!device || !__atomic_compare_exchange_n(&device->armed, &expected, ARMED_STARTING, 0,
+                                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)){
+            while(i--)
+                __atomic_store_n(&((struct device*)device_handles[i])->armed, ARMED, __ATOMIC_RELAXED);
+            return device ? UADI_ERROR : UADI_INVALID_HANDLE;
+        }
+    }
+
+    /* Every device gets the same deadline, the producers sleep and poll
+     * towards it on their own, so the order of the wakeups doesn't matter. */
+    start_ns = monotonic_ns() + lead_ns;
+    for(i = 0; i < device_count; ++i){
+        device = (struct device*)device_handles[i];
+        device->start_ns = start_ns;
+        if(device->period_ns){
+            __atomic_store_n(&device->armed, 0, __ATOMIC_RELEASE);
+            add_paced_device(&device->connection->pacer, device, start_ns);
+        } else {
+            /* uadi_stop waits for the producer to report being armed again. */
+            set_producer_state(device, UADI_PRODUCER_FILLING);
+            __atomic_store_n(&device->armed, 0, __ATOMIC_SEQ_CST);
+            uadi_parker_wake(&device->parker);
+        }
+    }
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_start(uadi_device_handle device_handle)
+{
+    return uadi_start_group(&device_handle, 1, 0);
+}
+
+uadi_status uadi_stop(uadi_device_handle device_handle)
+{
+    struct device* device = (struct device*)device_handle;
+
+    if(!device)
+        return UADI_INVALID_HANDLE;
+    if(__atomic_load_n(&device->armed, __ATOMIC_ACQUIRE))
+        return UADI_ERROR;
+
+    __atomic_store_n(&device->armed, ARMED, __ATOMIC_SEQ_CST);
+    if(device->period_ns){
+        remove_paced_device(&device->connection->pacer, device);
+        set_producer_state(device, UADI_PRODUCER_ARMED);
+    } else {
+        /* The producer finishes the chunk at hand and delivers it before it
+         * arms itself, which takes no longer than one chunk. */
+        uadi_parker_wake(&device->parker);
+        while(__atomic_load_n(&device->producer_state, __ATOMIC_ACQUIRE) != UADI_PRODUCER_ARMED)
+            sched_yield();
+    }
+    if(device->options.delivery == UADI_DELIVERY_POOL)
+        wait_for_delivery(device);
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_peek_latest(
+    uadi_device_handle device_handle,
+    float* samples,
+    size_t sample_count,
+    unsigned long long* timestamp_ns)
+{
+    struct device* device = (struct device*)device_handle;
+    unsigned long long written;
+    unsigned long long begun;
+    unsigned long long timestamp;
+    size_t begin;
+    size_t first;
+
+    if(!device || (!samples && sample_count))
+        return UADI_INVALID_HANDLE;
+    if(!device->history)
+        return UADI_NOT_SUPPORTED;
+    if(sample_count > device->history_mask + 1)
+        return UADI_BUFFER_TOO_SMALL;
+
+    for(;;){
+        written = __atomic_load_n(&device->history_written, __ATOMIC_ACQUIRE);
+        timestamp = __atomic_load_n(&device->history_timestamp, __ATOMIC_RELAXED);
+        if(written < sample_count)
+            return UADI_ERROR;
+        begin = (size_t)((written - sample_count) & device->history_mask);
+        first = device->history_mask + 1 - begin < sample_count
+            ? device->history_mask + 1 - begin : sample_count;
+        memcpy(samples, device->history + begin, first * sizeof(float));
+        memcpy(samples + first, device->history, (sample_count - first) * sizeof(float));
+
+        /* The copy is valid if nothing was published meanwhile, which also
+         * keeps the timestamp consistent, and the producer didn't start to
+         * overwrite the copied samples. */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        begun = __atomic_load_n(&device->history_begun, __ATOMIC_RELAXED);
+        if(__atomic_load_n(&device->history_written, __ATOMIC_RELAXED) == written
+           && begun - written + sample_count <= device->history_mask + 1)
+            break;
+    }
+    if(timestamp_ns)
+        *timestamp_ns = timestamp;
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_verify_chunk(
+    struct uadi_chunk_header const* header,
+    void const* datapack)
+{
+    if(!header || (!datapack && header->data_size))
+        return UADI_INVALID_HANDLE;
+    if(!(header->flags & UADI_CHUNK_CHECKSUM))
+        return UADI_NOT_SUPPORTED;
+    uadi_kernels_init();
+    return uadi_kernels.crc32c(0, datapack, header->data_size) == header->checksum
+        ? UADI_SUCCESS : UADI_CHECKSUM_MISMATCH;
+}
+
+/* Builds the pipeline outside of the lock, the producer only waits for the
+ * pointer swap. */
+static uadi_status set_pipeline(struct device* device, struct uadi_json const* stages)
+{
+    struct uadi_pipeline* pipeline = NULL;
+    struct uadi_pipeline* previous;
+    uadi_status status;
+
+    if(device->options.sample_format != UADI_FORMAT_FLOAT32 || device->mirror)
+        return UADI_NOT_SUPPORTED;
+    if(!stages || stages->type != UADI_JSON_ARRAY)
+        return UADI_ERROR;
+    /* An empty array removes the pipeline. */
+    if(stages->child){
+        status = uadi_pipeline_create(stages, &pipeline);
+        if(status != UADI_SUCCESS)
+            return status;
+    }
+    pthread_mutex_lock(&device->pipeline_lock);
+    previous = device->pipeline;
+    __atomic_store_n(&device->pipeline, pipeline, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&device->pipeline_lock);
+    uadi_pipeline_destroy(previous);
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_send_json(
+    uadi_device_handle device_handle,
+    uadi_chunk_ptr chunk_ptr)
+{
+    struct device* device = (struct device*)device_handle;
+    struct uadi_json* json;
+    char const* command;
+    char const* path;
+    uadi_status status = UADI_NOT_SUPPORTED;
+
+    if(!device || !chunk_ptr)
+        return UADI_INVALID_HANDLE;
+    json = uadi_json_parse((char const*)chunk_ptr);
+    if(!json)
+        return UADI_ERROR;
+
+    command = uadi_json_string(json, "command");
+    if(command && strcmp(command, "freeze") == 0 && device->recorder){
+        path = uadi_json_string(json, "path");
+        status = path ? uadi_recorder_freeze(device->recorder, path) : UADI_ERROR;
+    } else if(command && strcmp(command, "pipeline") == 0){
+        status = set_pipeline(device, uadi_json_member(json, "stages"));
+    } else if(device->driver->control){
+        status = device->driver->control(device->driver_state, (char const*)chunk_ptr);
+    }
+    uadi_json_free(json);
+    return status;
+}
 
 uadi_status uadi_release_device(uadi_device_handle device_handle)
 {
-    return 0;
+    struct device* device = (struct device*)device_handle;
+    struct connection* connection;
+    struct device** link;
+
+    if(!device)
+        return UADI_INVALID_HANDLE;
+    connection = device->connection;
+
+    pthread_mutex_lock(&connection->lock);
+    for(link = &connection->devices; *link && *link != device; link = &(*link)->next)
+        ;
+    if(!*link){
+        pthread_mutex_unlock(&connection->lock);
+        return UADI_INVALID_HANDLE;
+    }
+    *link = device->next;
+    pthread_mutex_unlock(&connection->lock);
+
+    retire_device(device);
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_get_statistics(
+    uadi_lib_handle lib_handle,
+    struct uadi_statistics* stats,
+    size_t stats_size)
+{
+    struct connection* connection = (struct connection*)lib_handle;
+    struct uadi_statistics total;
+    struct device* device;
+
+    if(!connection || !stats)
+        return UADI_INVALID_HANDLE;
+    pthread_mutex_lock(&connection->lock);
+    total = connection->released;
+    total.chunks_queued = 0;
+    total.devices_claimed = 0;
+    for(device = connection->devices; device; device = device->next){
+        add_device_statistics(device, &total);
+        ++total.devices_claimed;
+    }
+    pthread_mutex_unlock(&connection->lock);
+    copy_statistics(&total, stats, stats_size);
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_get_device_statistics(
+    uadi_device_handle device_handle,
+    struct uadi_statistics* stats,
+    size_t stats_size)
+{
+    struct device* device = (struct device*)device_handle;
+    struct uadi_statistics total;
+
+    if(!device || !stats)
+        return UADI_INVALID_HANDLE;
+    memset(&total, 0, sizeof(total));
+    add_device_statistics(device, &total);
+    total.devices_claimed = 1;
+    total.producer_state = (unsigned long long)__atomic_load_n(&device->producer_state, __ATOMIC_RELAXED);
+    copy_statistics(&total, stats, stats_size);
+    return UADI_SUCCESS;
+}
+
+uadi_status uadi_get_pipeline_statistics(
+    uadi_device_handle device_handle,
+    struct uadi_stage_statistics* stages,
+    size_t* stage_count)
+{
+    struct device* device = (struct device*)device_handle;
+    uadi_status status = UADI_NOT_SUPPORTED;
+    size_t count;
+
+    if(!device || !stage_count || (!stages && *stage_count))
+        return UADI_INVALID_HANDLE;
+    pthread_mutex_lock(&device->pipeline_lock);
+    if(device->pipeline){
+        count = uadi_pipeline_statistics(device->pipeline, stages, *stage_count);
+        status = count > *stage_count ? UADI_BUFFER_TOO_SMALL : UADI_SUCCESS;
+        *stage_count = count;
+    }
+    pthread_mutex_unlock(&device->pipeline_lock);
+    return status;
+}
+
+static char const* const trace_writer_names[UADI_TRACE_WRITERS] = {
+    "consumer", "producer", "delivery",
 };
 
+uadi_status uadi_export_trace(uadi_lib_handle lib_handle, char const* path)
+{
+    struct connection* connection = (struct connection*)lib_handle;
+    struct uadi_trace_clock now;
+    struct uadi_trace_event* events[UADI_TRACE_WRITERS];
+    size_t count[UADI_TRACE_WRITERS];
+    struct device* device;
+    double ns_per_tick = 1.0;
+    int status = UADI_SUCCESS;
+    int first = 1;
+    int pid;
+    int i;
+    FILE* out;
+
+    if(!connection || !path)
+        return UADI_INVALID_HANDLE;
+    out = fopen(path, "w");
+    if(!out)
+        return UADI_ERROR;
+
+    uadi_trace_clock_sample(&now);
+    if(now.ticks > connection->trace_origin.ticks)
+        ns_per_tick = (double)(now.ns - connection->trace_origin.ns)
+            / (double)(now.ticks - connection->trace_origin.ticks);
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    /* The connection lock keeps the devices from being freed meanwhile. */
+    pthread_mutex_lock(&connection->lock);
+    for(device = connection->devices; device; device = device->next){
+        if(!device->trace[0])
+            continue;
+        /* All rings are copied before the slow formatting, so they cover
+         * about the same period of time. */
+        for(i = 0; i < UADI_TRACE_WRITERS; ++i){
+            events[i] = (struct uadi_trace_event*)malloc(
+                (device->trace[i]->mask + 1) * sizeof(*events[i]));
+            count[i] = events[i] ? uadi_trace_snapshot(device->trace[i], events[i]) : 0;
+            if(!events[i])
+                status = UADI_INTERNAL_ERROR;
+        }
+        pid = (int)device->driver_index + 1;
+        uadi_trace_write_name(out, pid, -1, device->driver->description, &first);
+        for(i = 0; i < UADI_TRACE_WRITERS; ++i){
+            uadi_trace_write_name(out, pid, i, trace_writer_names[i], &first);
+            if(events[i])
+                uadi_trace_write_events(out, events[i], count[i], pid, i,
+                                        &connection->trace_origin, ns_per_tick, &first);
+            free(events[i]);
+        }
+    }
+    pthread_mutex_unlock(&connection->lock);
+    fputs("\n]}\n", out);
+    if(fclose(out) != 0 && status == UADI_SUCCESS)
+        status = UADI_ERROR;
+    return status;
+}
+
 uadi_status uadi_deinit(uadi_lib_handle lib_handle)
 {
-    return 0;
-};
\ No newline at end of file
+    struct connection* connection = (struct connection*)lib_handle;
+    struct device* device;
+
+    if(!connection)
+        return UADI_INVALID_HANDLE;
+
+    /* Devices the consumer forgot to release are released here. */
+    for(;;){
+        pthread_mutex_lock(&connection->lock);
+        device = connection->devices;
+        if(device)
+            connection->devices = device->next;
+        pthread_mutex_unlock(&connection->lock);
+        if(!device)
+            break;
+        retire_device(device);
+    }
+    stop_delivery_pool(&connection->pool);
+    stop_pacer(&connection->pacer);
+    pthread_mutex_destroy(&connection->lock);
+    free(connection);
+    return UADI_SUCCESS;
+}
@@ -9,6 +9,14 @@
  * available data producers, claiming and releasing devices, managing data 
  * chunks, and waiting for data. Detailed error codes and data management 
  * policies are provided for robust integration.
+ *
+ * Thread safety: every library handle owns its devices, producer threads and
+ * statistics. Calls on different library handles never share a lock, so 
+ * independent consumers in one process don't contend with each other. The 
+ * only cross-handle state is the exclusive claim of a device key, which is 
+ * resolved without locking. The contract of each function is documented with
+ * the function. The receive and recycle callbacks of a device are called from
+ * that device's producer thread, or from the thread releasing the device.
  */
 
 #ifndef UADI_TEMPLATE_H
@@ -17,10 +25,18 @@
 #include <stddef.h>
 
 /* _WIN32 Macro is defined by the compiler when compiling for Windows
- * Linux doesn't need any additional defines.
+ * Elsewhere the library is built with hidden visibility, so only the
+ * functions marked here are exported. They also have to be listed in the
+ * version script UaDI.map.
+ * UADI_STATIC is defined by consumers linking the static UaDI_static target,
+ * which must not export anything.
  */
-#ifdef _WIN32
+#if defined(UADI_STATIC)
+#define DLL_EXPORT
+#elif defined(_WIN32)
 #define DLL_EXPORT __declspec(dllexport)
+#elif defined(__GNUC__)
+#define DLL_EXPORT __attribute__((visibility("default")))
 #else
 #define DLL_EXPORT
 #endif
@@ -75,7 +91,7 @@ typedef void* uadi_device_handle;
  * library via the uadi_push_chunks(...) function.
  */
 typedef unsigned char* uadi_chunk_ptr;
-#define UADI_DEFAULT_CHUNK_SIZE 128 * 1024
+#define UADI_DEFAULT_CHUNK_SIZE (128 * 1024)
 
 /**
  * @brief Status code for uadi_receive_callback.
@@ -90,18 +106,51 @@ typedef unsigned char* uadi_chunk_ptr;
  */
 typedef int uadi_status;
 
+/**
+ * @brief Description of a filled data chunk.
+ * @see uadi_receive_struct
+ *
+ * The header is written by the producer thread while it fills a chunk and is
+ * read-only for the consumer. It lives in the library, not in the chunk, and 
+ * is valid until the receive callback returns. The structure is exactly one 
+ * cache line; new fields are carved out of the reserved bytes.
+ */
+struct uadi_chunk_header{
+    unsigned long long sequence;     // number of the chunk since the claim, from 0
+    unsigned long long timestamp_ns; // CLOCK_MONOTONIC when filling started
+    unsigned long long data_size;    // bytes of data in the datapack
+    unsigned int sample_count;       // samples in the datapack
+    unsigned int flags;              // UADI_CHUNK_*
+    unsigned long long stream_offset; // byte offset of the datapack in the stream
+    unsigned int sample_format;      // UADI_FORMAT_* of the samples
+    unsigned int checksum;           // CRC32C of the datapack, see UADI_CHUNK_CHECKSUM
+    unsigned int trigger_sample;     // first sample past the trigger, see UADI_CHUNK_TRIGGERED
+    unsigned char reserved[12];
+};
+
+/* Flags of struct uadi_chunk_header. Bits from UADI_CHUNK_DRIVER on are
+ * defined by the device. */
+#define UADI_CHUNK_MIRRORED 0x1u // in the mirrored ring, valid until the callback returns
+#define UADI_CHUNK_POOLED 0x2u   // lent from the chunk pool, see uadi_release_chunks
+#define UADI_CHUNK_CHECKSUM 0x4u // checksum is valid, see uadi_verify_chunk
+#define UADI_CHUNK_TRIGGERED 0x8u // a pipeline trigger fired, see trigger_sample
+#define UADI_CHUNK_DRIVER 0x10000u
+
 /** 
  * @brief Structure to receive data from the library.
  * @see uadi_receive_callback(...)
  *
  * This structure is used when receiving chunks of data from the library.
  * It contains pointers to information and data packets. The format of data 
- * packets is an array of floats. Information packets are JSON strings.
+ * packets is an array of floats, or of 16 bit floats if the device was
+ * claimed with another sample_format. Information packets are JSON strings.
+ * Data packets come with a header, for information packets it is NULL.
  */
 struct uadi_receive_struct{
     uadi_chunk_ptr infopack_ptr;
     uadi_chunk_ptr datapack_ptr;
     uadi_status status;
+    struct uadi_chunk_header const* header;
 };
 
 // Error codes
@@ -112,6 +161,7 @@ struct uadi_receive_struct{
 #define UADI_NO_DATA -4
 #define UADI_OUT_OF_CHUNKS -5
 #define UADI_NOT_SUPPORTED -6
+#define UADI_CHECKSUM_MISMATCH -7
 #define UADI_INTERNAL_ERROR -255
 
 /**
@@ -124,7 +174,7 @@ struct uadi_receive_struct{
  * used by the consumer to provide context for the function. It might be a
  * pointer to a queue for example.
  */
-typedef void(*uadi_receive_callback)(uadi_receive_struct*, void*);
+typedef void(*uadi_receive_callback)(struct uadi_receive_struct*, void*);
 
 /**
 * @brief Callback function for recycling unused chunks.
@@ -152,6 +202,8 @@ typedef void(*uadi_recycle_unused_chunk_callback)(uadi_chunk_ptr, size_t, void*)
  * It needs to be made sure, that after a device has been released, the library 
  * handle is still valid, until the consumer calls uadi_deinit(...). This has 
  * to be done in order to keep RAII intact.
+ * Thread safety: may be called concurrently from any thread. Every call 
+ * creates an independent connection.
  */
 DLL_EXPORT uadi_status uadi_init(uadi_lib_handle* lib_handle);
 
@@ -168,6 +220,7 @@ DLL_EXPORT uadi_status uadi_init(uadi_lib_handle* lib_handle);
  * call would fail with UADI_BUFFER_TOO_SMALL. In that case, the consumer would 
  * have to call the function again with a larger chunk of memory.
  * A consumer is not required to call this function.
+ * Thread safety: may be called concurrently from any thread.
  */
 DLL_EXPORT uadi_status uadi_get_meta_data(
     uadi_lib_handle lib_handle, 
@@ -187,12 +240,71 @@ DLL_EXPORT uadi_status uadi_get_meta_data(
  * one to receive its data. A device is claimed exclusively, meaning, that only 
  * one consumer at a time can claim it. The received device list is a 
  * JSON-formatted string, containing all available devices.
+ * Thread safety: may be called concurrently from any thread.
  */
 DLL_EXPORT uadi_status uadi_enumerate(
     uadi_lib_handle handle, 
     char* device_list,
     size_t device_list_size);
 
+/* Version of this API, incremented whenever functions, options or fields are
+ * added. Reported as api_version in struct uadi_capabilities. */
+#define UADI_API_VERSION 5
+
+/* Features reported in struct uadi_capabilities */
+#define UADI_FEATURE_NON_TEMPORAL (1ull << 0)   // fill_mode
+#define UADI_FEATURE_BUSY_POLL (1ull << 1)      // wait_strategy polling modes
+#define UADI_FEATURE_DELIVERY_POOL (1ull << 2)  // delivery
+#define UADI_FEATURE_TRACE (1ull << 3)          // trace_events, uadi_export_trace
+#define UADI_FEATURE_MIRROR (1ull << 4)         // mirror_size, shared memory ring
+#define UADI_FEATURE_LATEST_SAMPLES (1ull << 5) // latest_samples, uadi_peek_latest
+#define UADI_FEATURE_RECORDER (1ull << 6)       // recorder_chunks
+#define UADI_FEATURE_PACING (1ull << 7)         // sample_rate
+#define UADI_FEATURE_CHUNK_POOL (1ull << 8)     // pool_chunks, uadi_release_chunks
+#define UADI_FEATURE_HUGE_PAGES (1ull << 9)     // pool_huge_pages
+#define UADI_FEATURE_START_STOP (1ull << 10)    // start_armed, uadi_start_group, uadi_stop
+#define UADI_FEATURE_ARROW (1ull << 11)         // uadi_export_arrow, see UaDI_arrow.h
+#define UADI_FEATURE_FLOAT16 (1ull << 12)       // sample_format UADI_FORMAT_FLOAT16
+#define UADI_FEATURE_BFLOAT16 (1ull << 13)      // sample_format UADI_FORMAT_BFLOAT16
+#define UADI_FEATURE_CHECKSUM (1ull << 14)      // checksum, uadi_verify_chunk
+#define UADI_FEATURE_PIPELINE (1ull << 15)      // "pipeline" command, uadi_get_pipeline_statistics
+#define UADI_FEATURE_EXPRESSION (1ull << 16)    // "expression" pipeline stage
+
+/**
+ * @brief Fixed facts about a producer library.
+ * @see uadi_get_capabilities(...)
+ * New fields are only ever appended, the consumer passes the size of the 
+ * structure it knows about.
+ */
+struct uadi_capabilities{
+    unsigned int api_version;         // UADI_API_VERSION the library was built with
+    unsigned int device_count;        // devices listed by uadi_enumerate
+    unsigned long long features;      // UADI_FEATURE_* supported on this system
+    size_t chunk_size_min;            // smallest chunk_size of the device options
+    size_t chunk_size_max;            // largest chunk_size of the device options
+    size_t chunk_size_multiple;       // every chunk_size is a multiple of this
+    size_t default_chunk_size;        // chunk_size unless set in the options
+    size_t chunk_alignment;           // alignment chunks must have
+    size_t preferred_chunk_alignment; // alignment for the fastest fill
+    size_t max_chunks;                // chunks a device can hold at once
+};
+
+/**
+ * @brief This function reads the capabilities of the library.
+ * @param lib_handle the library handle.
+ * @param caps Pointer to the capabilities to fill.
+ * @param caps_size Size of the capabilities structure known to the consumer.
+ * @return uadi_status Status code of the operation.
+ * The binary counterpart of uadi_get_meta_data(...) for feature detection,
+ * which doesn't require parsing JSON. Features that depend on the operating
+ * system, like UADI_FEATURE_MIRROR, are only reported where they work.
+ * Thread safety: may be called concurrently from any thread.
+ */
+DLL_EXPORT uadi_status uadi_get_capabilities(
+    uadi_lib_handle lib_handle,
+    struct uadi_capabilities* caps,
+    size_t caps_size);
+
 /**
  * @brief This function claims a data producer device.
  * @param lib_handle Pointer to the library handle.
@@ -227,6 +339,10 @@ DLL_EXPORT uadi_status uadi_enumerate(
  * by using the recycle function.
  * The user data pointer is used by the consumer to provide context for the 
  * function. It might be a pointer to a queue for example.
+ * The receive callback may already be called before this function returns, 
+ * the device handle is written before that happens.
+ * Thread safety: may be called concurrently from any thread. Claiming the same
+ * device key concurrently succeeds for exactly one caller.
  */
 DLL_EXPORT uadi_status uadi_claim_device(
     uadi_lib_handle lib_handle, 
@@ -239,6 +355,216 @@ DLL_EXPORT uadi_status uadi_claim_device(
     uadi_chunk_ptr* chunk_array, 
     size_t chunk_count);
 
+/* Warmup modes of struct uadi_device_options */
+#define UADI_WARMUP_NONE 0   // chunks are faulted in by the producer while filling
+#define UADI_WARMUP_CLAIM 1  // chunks given to uadi_claim_device_ex are pre-faulted
+#define UADI_WARMUP_ALWAYS 2 // every pushed chunk is pre-faulted as well
+
+/* Fill modes of struct uadi_device_options */
+#define UADI_FILL_AUTO 0          // non-temporal from UADI_NON_TEMPORAL_THRESHOLD on
+#define UADI_FILL_TEMPORAL 1      // regular stores, the chunk stays in the cache
+#define UADI_FILL_NON_TEMPORAL 2  // streaming stores that bypass the cache
+#define UADI_NON_TEMPORAL_THRESHOLD (128 * 1024)
+
+/* Wait strategies of struct uadi_device_options */
+#define UADI_WAIT_PARK 0      // sleep as soon as the producer runs out of chunks
+#define UADI_WAIT_ADAPTIVE 1  // spin, then yield, then sleep
+#define UADI_WAIT_BUSY_POLL 2 // spin on the free ring, never sleep
+
+/* Sample formats of struct uadi_device_options and struct uadi_chunk_header */
+#define UADI_FORMAT_FLOAT32 0  // IEEE single precision
+#define UADI_FORMAT_FLOAT16 1  // IEEE half precision, 11 bit significand
+#define UADI_FORMAT_BFLOAT16 2 // upper half of a float, 8 bit significand
+
+/* Delivery modes of struct uadi_device_options */
+#define UADI_DELIVERY_INLINE 0 // the producer thread runs the receive callback
+#define UADI_DELIVERY_POOL 1   // a delivery thread of the library handle runs it
+
+/**
+ * @brief Per-device options for uadi_claim_device_ex(...).
+ * @see uadi_device_options_init(...)
+ * The structure is versioned by its size. The consumer initializes it with 
+ * uadi_device_options_init(...), which sets the size and the defaults, and 
+ * only changes the fields it cares about. New fields are only ever appended, 
+ * fields unknown to an older consumer keep their defaults.
+ *
+ * warmup: Freshly allocated chunks take a page fault on every page the 
+ * producer writes first, which shows up as latency spikes in the first 
+ * seconds of an acquisition. With UADI_WARMUP_CLAIM the chunks given at claim
+ * time are pre-faulted (MADV_POPULATE_WRITE, or a write to every page) before
+ * the producer starts. UADI_WARMUP_ALWAYS also pre-faults every chunk passed 
+ * to uadi_push_chunks(...) on the pushing thread, before it enters the free 
+ * ring, which is meant for consumers that keep pushing newly allocated 
+ * chunks. Pre-faulting clobbers the content of the chunk.
+ *
+ * chunk_size: Size in bytes of every chunk given to this device, a multiple 
+ * of the sample size, see sample_format. Defaults to UADI_DEFAULT_CHUNK_SIZE.
+ *
+ * fill_mode: A chunk the producer never reads again doesn't need to pass 
+ * through the cache. Non-temporal stores keep large chunks from evicting the
+ * working set of other threads sharing the last level cache, at the price of
+ * the consumer reading the chunk from memory. UADI_FILL_AUTO uses them for 
+ * chunks of at least UADI_NON_TEMPORAL_THRESHOLD bytes. All stores are fenced 
+ * before the chunk is handed to the receive callback.
+ *
+ * wait_strategy: What the producer thread does when its free ring is empty.
+ * Waking a sleeping producer from uadi_push_chunks(...) costs a system call 
+ * on both sides and tens of microseconds. UADI_WAIT_ADAPTIVE spins on the 
+ * free ring for spin_ns, then yields the CPU until yield_ns have passed in 
+ * total and only then sleeps, so a chunk pushed shortly after is picked up 
+ * within hundreds of nanoseconds while an idle device doesn't burn a core.
+ * UADI_WAIT_BUSY_POLL never sleeps and should only be used with a dedicated
+ * core. The current state is reported as producer_state in the statistics.
+ *
+ * delivery: With UADI_DELIVERY_INLINE the producer thread fills a chunk and
+ * runs the receive callback itself, so a slow callback stalls the producer.
+ * With UADI_DELIVERY_POOL filled chunks are queued and the callbacks run on a
+ * small pool of delivery threads shared by the devices of the library handle,
+ * while the producer keeps filling chunks. Chunks of one device are still
+ * delivered one at a time and in sequence. At most 256 filled chunks wait for
+ * delivery; beyond that the producer waits according to wait_strategy and
+ * counts a producer stall.
+ *
+ * trace_events: Number of chunk state transitions kept per recording thread
+ * for uadi_export_trace(...). Each transition is stamped with the timestamp
+ * counter into a ring only that thread writes to, the oldest transitions are
+ * overwritten. 0, the default, disables tracing, which leaves a single well
+ * predicted branch per transition.
+ *
+ * mirror_size: Sliding window consumers otherwise have to copy the end of one
+ * chunk in front of the next. With a mirror_size the device doesn't fill
+ * chunks of the consumer but a library owned ring of mirror_size bytes
+ * (rounded up to whole pages), mapped twice back to back in virtual memory.
+ * Every datapack points into that ring and is contiguous, even where it wraps
+ * around. Such a device is claimed without chunks and uadi_push_chunks(...)
+ * returns UADI_NOT_SUPPORTED. The datapack is valid until the callback
+ * returns, together with the mirror_history bytes before it, which always
+ * are the end of the previous datapacks in stream order, so a window of
+ * up to mirror_history + data_size bytes ending at the end of the datapack
+ * is available without copying. header.stream_offset tells where the
+ * datapack starts in the stream. The producer waits according to
+ * wait_strategy while the ring holds no space for the next chunk without
+ * overwriting the history or chunks awaiting delivery. Requires
+ * chunk_size + mirror_history <= mirror_size; claiming fails with
+ * UADI_NOT_SUPPORTED where the ring can't be mapped (Linux only).
+ *
+ * latest_samples: Number of most recent samples the device keeps for
+ * uadi_peek_latest(...), rounded up to a power of two. The producer copies
+ * the end of every filled chunk into this history, 0 disables it.
+ *
+ * recorder_chunks: Number of most recent chunks kept by the flight recorder
+ * of the device, 0 disables it. To keep the last N seconds, this is N times
+ * the chunk rate. The producer copies every filled chunk into the recorder.
+ * The command {"command":"freeze","path":"<file>"} sent with
+ * uadi_send_json(...) freezes the recorded chunks and writes them to the file
+ * on a separate thread while acquisition and recording continue from an empty
+ * recorder. The recorder is double buffered and takes twice
+ * recorder_chunks * chunk_size bytes. The file holds the frozen chunks
+ * oldest first, each as its struct uadi_chunk_header followed by data_size
+ * bytes of samples.
+ *
+ * sample_rate: Samples per second of a paced device, 0 (the default) fills
+ * chunks as fast as they come in. Paced devices have no thread of their own.
+ * All paced devices of a library handle are driven by one pacer thread from
+ * a hierarchical timing wheel with a resolution of 100 us, which fills the
+ * chunks of all devices due in the same tick in one batch, so thousands of
+ * paced devices don't need thousands of sleeping threads. With
+ * UADI_DELIVERY_INLINE their receive callbacks run on the pacer thread and
+ * delay every other paced device, UADI_DELIVERY_POOL avoids that. A chunk
+ * that can't be filled when due, because no chunk was pushed, is retried
+ * with every tick; a device that falls behind by more than one chunk drops
+ * the backlog instead of catching up in a burst.
+ *
+ * pool_chunks: Number of chunks of a library owned chunk pool, 0 (the
+ * default) uses the chunks of the consumer. With a pool the library
+ * allocates pool_chunks chunks of chunk_size bytes itself, aligned as the
+ * device requires, and the device is claimed without chunks. Every datapack
+ * is a pool chunk lent to the consumer, who may keep it beyond the callback
+ * and gives it back with uadi_release_chunks(...); uadi_push_chunks(...)
+ * returns UADI_NOT_SUPPORTED. Chunks still lent when the device is released
+ * become invalid. At most 4096 chunks, the capacity of the free ring. With
+ * warmup other than UADI_WARMUP_NONE the pool is pre-faulted at claim time.
+ *
+ * pool_huge_pages: Back the chunk pool with huge pages, which saves TLB
+ * misses when the consumer walks through many large chunks. Explicit huge
+ * pages are used where the system has them reserved, transparent huge pages
+ * otherwise; the pool is rounded up to whole huge pages.
+ *
+ * sample_format: Format of the samples in the datapacks. UADI_FORMAT_FLOAT16
+ * and UADI_FORMAT_BFLOAT16 halve the memory and recording bandwidth compared
+ * with UADI_FORMAT_FLOAT32, the default, and keep floating point semantics;
+ * half precision represents integers up to 2048 exactly, enough for a 12 bit
+ * converter, bfloat16 keeps the range of a float. The producer writes them
+ * directly, converting with F16C, AVX-512 or AVX512-BF16 instructions where
+ * available, and always with regular stores. chunk_size has to be a
+ * multiple of the sample size. uadi_peek_latest(...) still returns floats.
+ * Claiming fails with UADI_NOT_SUPPORTED if the device can't produce the
+ * format.
+ *
+ * start_armed: Claim the device armed but idle. The device takes chunks but
+ * doesn't fill any until it is started with uadi_start_group(...) or
+ * uadi_start(...), so that devices claimed one after another start streaming
+ * at the same instant.
+ *
+ * checksum: Compute a CRC32C of every datapack right after it is filled and
+ * store it in the checksum field of its header, flagged with
+ * UADI_CHUNK_CHECKSUM. The checksum travels with the header into the flight
+ * recorder's files, so corruption on the way through shared memory, disk or
+ * a replay can be detected with uadi_verify_chunk(...). The CRC runs on the
+ * crc32 instruction of SSE4.2 in three interleaved streams while the chunk
+ * is still in the cache, a table driven variant elsewhere.
+ */
+struct uadi_device_options{
+    size_t size;
+    int warmup;
+    size_t chunk_size;
+    int fill_mode;
+    int wait_strategy;
+    unsigned long long spin_ns;
+    unsigned long long yield_ns;
+    int delivery;
+    size_t trace_events;
+    size_t mirror_size;
+    size_t mirror_history;
+    size_t latest_samples;
+    size_t recorder_chunks;
+    unsigned long long sample_rate;
+    size_t pool_chunks;
+    int pool_huge_pages;
+    int start_armed;
+    int sample_format;
+    int checksum;
+};
+
+/**
+ * @brief This function fills device options with their defaults.
+ * @param options Pointer to the options to initialize.
+ * Thread safety: may be called concurrently from any thread.
+ */
+DLL_EXPORT void uadi_device_options_init(struct uadi_device_options* options);
+
+/**
+ * @brief This function claims a data producer device with non-default options.
+ * @param options Pointer to the device options, or NULL for the defaults.
+ * @return uadi_status Status code of the operation.
+ * @see uadi_claim_device(...)
+ * @see uadi_device_options
+ * All other parameters and the thread safety are the same as for 
+ * uadi_claim_device(...), which is equivalent to calling this function with
+ * NULL options.
+ */
+DLL_EXPORT uadi_status uadi_claim_device_ex(
+    uadi_lib_handle lib_handle, 
+    uadi_device_handle* device_handle, 
+    char const* device_key, 
+    uadi_receive_callback receive_callback, 
+    void* receive_context,
+    uadi_recycle_unused_chunk_callback recycle_callback,
+    void* recycle_context,
+    uadi_chunk_ptr* chunk_array, 
+    size_t chunk_count,
+    struct uadi_device_options const* options);
+
 /**
  * @brief This function is used to push chunks of memory to a device.
  * @param device_handle Pointer to the device handle.
@@ -248,12 +574,129 @@ DLL_EXPORT uadi_status uadi_claim_device(
  * The push chunks function will hand over chunks of memory to a device inside 
  * the library. Any data that is stored in the chunk will be overwritten by the 
  * device.
+ * This is the hot path of every acquisition. It does not allocate or take a 
+ * lock unless the device is idle waiting for chunks. If the device can't queue
+ * all chunks at once, none of them are taken and UADI_BUFFER_TOO_SMALL is 
+ * returned. Devices filling a mirrored ring (see mirror_size in 
+ * uadi_device_options) take no chunks and return UADI_NOT_SUPPORTED.
+ * Thread safety: calls for the same device must be serialized by the 
+ * consumer, e.g. by only pushing from within the receive callback or only from
+ * one consumer thread. Different devices may be fed concurrently.
  */
 DLL_EXPORT uadi_status uadi_push_chunks(
     uadi_device_handle device_handle, 
     uadi_chunk_ptr* chunk_array, 
     size_t chunk_count);
 
+/**
+ * @brief This function gives chunks lent from a chunk pool back to a device.
+ * @param device_handle the device handle.
+ * @param chunk_array Datapacks received from this device.
+ * @param chunk_count Number of chunks in the chunk array.
+ * @return uadi_status Status code of the operation.
+ * @see pool_chunks in uadi_device_options
+ * The counterpart of uadi_push_chunks(...) for devices with a library owned
+ * chunk pool. The chunks are filled again by the device and must not be
+ * touched by the consumer afterwards. Returns UADI_NOT_SUPPORTED if the
+ * device has no pool and UADI_ERROR, without taking any chunk, if one of the
+ * chunks isn't a chunk of its pool or isn't lent to the consumer, because it
+ * has already been released, also earlier in the same array.
+ * Thread safety: the same as for uadi_push_chunks(...).
+ */
+DLL_EXPORT uadi_status uadi_release_chunks(
+    uadi_device_handle device_handle,
+    uadi_chunk_ptr* chunk_array,
+    size_t chunk_count);
+
+/**
+ * @brief This function starts a group of armed devices at the same instant.
+ * @param device_handles Devices claimed with start_armed or stopped with
+ * uadi_stop(...), of any library handle.
+ * @param device_count Number of devices in the group.
+ * @param lead_ns Time from now to the start of the group.
+ * @return uadi_status UADI_ERROR, without starting any device, if one of
+ * them isn't armed or a device is listed more than once.
+ * @see start_armed in uadi_device_options
+ * All devices are given the same deadline, lead_ns from now. Their producers
+ * sleep until shortly before it and poll the clock for the rest, so the
+ * first chunks of all devices start filling within microseconds of each
+ * other, provided every producer has a core to run on. The lead time should
+ * cover the time to wake the producers, a millisecond is plenty. Paced
+ * devices have their first chunk due one period after the deadline, all in
+ * the same tick.
+ * Thread safety: must not be called concurrently for the same device.
+ */
+DLL_EXPORT uadi_status uadi_start_group(
+    uadi_device_handle* device_handles,
+    size_t device_count,
+    unsigned long long lead_ns);
+
+/**
+ * @brief This function starts a device claimed with start_armed or stopped
+ * with uadi_stop(...).
+ * @param device_handle the device handle.
+ * @return uadi_status UADI_ERROR if the device is running.
+ * Equivalent to uadi_start_group(...) with just this device and no lead
+ * time. The device continues with the chunks left in its free ring, the
+ * sequence numbers and stream offsets continue where they stopped.
+ * Thread safety: the same as for uadi_stop(...).
+ */
+DLL_EXPORT uadi_status uadi_start(uadi_device_handle device_handle);
+
+/**
+ * @brief This function pauses a device without releasing it.
+ * @param device_handle the device handle.
+ * @return uadi_status UADI_ERROR if the device is already stopped.
+ * The producer finishes the chunk it is filling, and the call returns once
+ * every filled chunk has been handed to the receive callback. The claim, the
+ * producer thread and the chunks in the free ring are kept, so a measurement
+ * is restarted with uadi_start(...) or uadi_start_group(...) in microseconds
+ * instead of releasing and claiming the device again. A stopped device
+ * keeps taking pushed chunks.
+ * This function must not be called from within the receive callback.
+ * Thread safety: must not be called concurrently with uadi_start(...),
+ * uadi_start_group(...) or uadi_release_device(...) for the same device.
+ */
+DLL_EXPORT uadi_status uadi_stop(uadi_device_handle device_handle);
+
+/**
+ * @brief This function copies the most recent samples of a device.
+ * @param device_handle the device handle.
+ * @param samples Array receiving sample_count samples, oldest first.
+ * @param sample_count Number of samples to copy, at most latest_samples.
+ * @param timestamp_ns Receives the CLOCK_MONOTONIC time at which the newest
+ * sample was published, may be NULL.
+ * @return uadi_status UADI_NOT_SUPPORTED if the device keeps no history,
+ * UADI_BUFFER_TOO_SMALL if it keeps fewer than sample_count samples and
+ * UADI_ERROR while fewer than sample_count samples have been produced.
+ * Meant for consumers like live plots, which only need to look at the newest
+ * data now and then. The copy is taken without a lock and never blocks the
+ * producer; if the producer publishes new samples during the copy, the copy
+ * is simply retried.
+ * Thread safety: may be called concurrently from any thread, including the
+ * receive callback.
+ */
+DLL_EXPORT uadi_status uadi_peek_latest(
+    uadi_device_handle device_handle,
+    float* samples,
+    size_t sample_count,
+    unsigned long long* timestamp_ns);
+
+/**
+ * @brief This function checks a datapack against the checksum in its header.
+ * @param header Header of the datapack, as received or read from a recording.
+ * @param datapack The header->data_size bytes of the datapack.
+ * @return uadi_status UADI_SUCCESS if the datapack matches its checksum,
+ * UADI_CHECKSUM_MISMATCH if it doesn't and UADI_NOT_SUPPORTED if the header
+ * carries no checksum.
+ * @see checksum in uadi_device_options
+ * Needs no library or device handle, so recordings can be checked offline.
+ * Thread safety: may be called concurrently from any thread.
+ */
+DLL_EXPORT uadi_status uadi_verify_chunk(
+    struct uadi_chunk_header const* header,
+    void const* datapack);
+
 /**
  * @brief This function sends a JSON-formatted string to a device.
  * @param device_handle the device handle.
@@ -263,6 +706,39 @@ DLL_EXPORT uadi_status uadi_push_chunks(
  * It is not part of the generic interface, which control data is allowed.
  * If a device is attached that doesn't support any control data, this function
  * will return UADI_NOT_SUPPORTED.
+ * The chunk holds a null terminated JSON object with a "command" member. The
+ * iota devices understand {"command":"freeze","path":"<file>"}, which dumps
+ * the flight recorder (see recorder_chunks in uadi_device_options). It
+ * returns as soon as the recorder is frozen, before the file is written, and
+ * UADI_ERROR if nothing has been recorded or the previous dump is still being
+ * written.
+ * {"command":"pipeline","stages":[...]} replaces the processing pipeline of a
+ * float32 device, an empty array removes it. The producer runs every
+ * datapack through the stages right after filling it, before the checksum,
+ * the history and the recorder see it. The chunk is processed in tiles of
+ * 4096 samples, each tile passing through all stages while it is in the L1
+ * cache, so a chain of stages costs one pass over the memory. Stages are
+ * objects with a "stage" member:
+ * - {"stage":"scale","gain":g,"offset":o}: gain * x + offset.
+ * - {"stage":"fir","taps":[h0,...]}: FIR filter of up to 256 taps.
+ * - {"stage":"decimate","factor":n}: keeps every n-th sample; data_size and
+ *   sample_count of the header shrink and stream_offset counts the bytes of
+ *   the datapacks as delivered, so the next datapack follows on.
+ * - {"stage":"statistics"}: minimum, maximum, mean and root mean square of
+ *   each datapack, see uadi_get_pipeline_statistics(...).
+ * - {"stage":"trigger","level":l,"edge":"rising"|"falling"}: flags datapacks
+ *   crossing the level with UADI_CHUNK_TRIGGERED and sets trigger_sample.
+ * - {"stage":"expression","expression":"sqrt(i*i + q*q)","channels":["i","q"]}:
+ *   replaces every frame of interleaved channels, up to 16, by the value of
+ *   the expression, without channels every sample is a frame named x. The
+ *   expression knows + - * /, parentheses, numbers and abs, sqrt, min, max
+ *   and clamp(x, low, high); it is compiled once into a bytecode that is
+ *   interpreted over blocks of 256 frames.
+ * At most 16 stages; the filter and trigger state carries over from chunk to
+ * chunk. Pipelines are not supported with a mirrored ring.
+ * Invalid JSON and invalid stages are rejected with UADI_ERROR, unknown
+ * commands with UADI_NOT_SUPPORTED.
+ * Thread safety: may be called concurrently from any thread.
  */
 DLL_EXPORT uadi_status uadi_send_json(
     uadi_device_handle device_handle, 
@@ -280,15 +756,131 @@ DLL_EXPORT uadi_status uadi_send_json(
  * sure, that the callback function is called with all remaining chunks in the 
  * devices queue. Empty chunks will be propagated back to the consumer as info-
  * packs, containing nothing but a terminating zero.
+ * If a recycle callback was given in uadi_claim_device(...), empty chunks are 
+ * handed to it instead.
+ * This function must not be called from within the receive callback.
+ * Thread safety: must be called exactly once per device and not concurrently
+ * with any other call on the same device handle.
  */
 DLL_EXPORT uadi_status uadi_release_device(uadi_device_handle device_handle);
 
+/**
+ * @brief Counters of a device or of all devices of a library handle.
+ * @see uadi_get_statistics(...)
+ * @see uadi_get_device_statistics(...)
+ * New fields are only ever appended, the consumer passes the size of the 
+ * structure it knows about.
+ */
+struct uadi_statistics{
+    unsigned long long chunks_pushed;    // chunks accepted by uadi_push_chunks
+    unsigned long long pushes_rejected;  // uadi_push_chunks calls that didn't fit
+    unsigned long long chunks_delivered; // chunks handed to the receive callback
+    unsigned long long chunks_returned;  // unused chunks given back on release
+    unsigned long long producer_waits;   // times a producer ran out of chunks
+    unsigned long long chunks_queued;    // chunks currently waiting to be filled
+    unsigned long long devices_claimed;  // currently claimed devices
+    unsigned long long chunks_warmed;    // chunks pre-faulted before filling
+    unsigned long long producer_parks;   // times a producer went to sleep
+    unsigned long long producer_state;   // UADI_PRODUCER_*, only per device
+    unsigned long long producer_stalls;  // times filled chunks waited for delivery
+    unsigned long long chunks_awaiting_delivery; // filled, callback not yet run
+    unsigned long long recordings_written; // flight recorder dumps written
+    unsigned long long recordings_failed;  // flight recorder dumps that failed
+};
+
+/* Producer states reported in struct uadi_statistics */
+#define UADI_PRODUCER_FILLING 0  // filling chunks or running the callback
+#define UADI_PRODUCER_SPINNING 1 // busy polling the free ring
+#define UADI_PRODUCER_YIELDING 2 // polling the free ring, yielding the CPU
+#define UADI_PRODUCER_PARKED 3   // asleep until chunks are pushed
+#define UADI_PRODUCER_STOPPED 4
+#define UADI_PRODUCER_PACED 5    // waiting for the next period of a paced device
+#define UADI_PRODUCER_ARMED 6    // armed or stopped, waiting for a start
+
+/**
+ * @brief This function reads the statistics of all devices of a library handle.
+ * @param lib_handle the library handle.
+ * @param stats Pointer to the statistics to fill.
+ * @param stats_size Size of the statistics structure known to the consumer.
+ * @return uadi_status Status code of the operation.
+ * Devices that have already been released are included in the totals.
+ * Thread safety: may be called concurrently from any thread. It only 
+ * synchronizes with claims and releases on the same library handle.
+ */
+DLL_EXPORT uadi_status uadi_get_statistics(
+    uadi_lib_handle lib_handle,
+    struct uadi_statistics* stats,
+    size_t stats_size);
+
+/**
+ * @brief This function reads the statistics of a single device.
+ * @param device_handle the device handle.
+ * @param stats Pointer to the statistics to fill.
+ * @param stats_size Size of the statistics structure known to the consumer.
+ * @return uadi_status Status code of the operation.
+ * Thread safety: may be called concurrently from any thread, including the 
+ * receive callback. It doesn't take any lock.
+ */
+DLL_EXPORT uadi_status uadi_get_device_statistics(
+    uadi_device_handle device_handle,
+    struct uadi_statistics* stats,
+    size_t stats_size);
+
+/**
+ * @brief Counters and results of one stage of a processing pipeline.
+ * @see uadi_get_pipeline_statistics(...)
+ */
+struct uadi_stage_statistics{
+    char stage[16];             // stage type, e.g. "fir"
+    unsigned long long chunks;  // chunks processed
+    unsigned long long samples; // samples passed into the stage
+    unsigned long long busy_ns; // time spent in the stage
+    double results[4];          // results of the last chunk, depending on the stage
+};
+
+/**
+ * @brief This function reads the per-stage statistics of a device's pipeline.
+ * @param device_handle the device handle.
+ * @param stages Array receiving the statistics, in the order of the stages.
+ * @param stage_count Capacity of the array, receives the number of stages.
+ * @return uadi_status UADI_NOT_SUPPORTED if the device has no pipeline and
+ * UADI_BUFFER_TOO_SMALL if it has more stages than fit, the first ones are
+ * copied anyway.
+ * @see "pipeline" in uadi_send_json(...)
+ * The results are minimum, maximum, mean and root mean square for a
+ * statistics stage and the number of triggered datapacks for a trigger.
+ * Thread safety: may be called concurrently from any thread, including the
+ * receive callback. It briefly blocks the producer.
+ */
+DLL_EXPORT uadi_status uadi_get_pipeline_statistics(
+    uadi_device_handle device_handle,
+    struct uadi_stage_statistics* stages,
+    size_t* stage_count);
+
+/**
+ * @brief This function writes the chunk lifetime trace of all claimed devices.
+ * @param lib_handle the library handle.
+ * @param path File the trace is written to, in the Chrome trace event JSON
+ * format understood by chrome://tracing and ui.perfetto.dev.
+ * @return uadi_status UADI_ERROR if the file can't be written.
+ * Only devices claimed with trace_events set are traced. Each chunk is shown
+ * as a track of the states it passed through: free ring, filling, filled,
+ * callback and consumer, each device as a process with one thread per
+ * recording side. Devices that have already been released are not included.
+ * Thread safety: may be called concurrently from any thread. Tracing
+ * continues while the trace is written.
+ */
+DLL_EXPORT uadi_status uadi_export_trace(uadi_lib_handle lib_handle, char const* path);
+
 /**
  * @brief This function deinitializes the library.
  * @param lib_handle Pointer to the library handle.
  * @return uadi_status Status code of the operation.
  * @see uadi_init(...)
  * After the library is deinitialized, it is no longer usable.
+ * Devices that are still claimed are released first.
+ * Thread safety: must not be called concurrently with any other call on the
+ * same library handle or one of its device handles.
  */
 DLL_EXPORT uadi_status uadi_deinit(uadi_lib_handle lib_handle);
 
@@ -0,0 +1,102 @@
+/**
+ * @file UaDI_trace.c
+ * @brief Trace rings and their export to the Chrome trace event format.
+ */
+
+#include "UaDI_trace.h"
+
+#include <string.h>
+#include <time.h>
+
+struct uadi_trace_ring* uadi_trace_ring_create(size_t capacity)
+{
+    struct uadi_trace_ring* ring;
+    size_t size = 1;
+    while(size < capacity)
+        size <<= 1;
+    ring = (struct uadi_trace_ring*)uadi_aligned_calloc(
+        UADI_CACHE_LINE, sizeof(*ring) + size * sizeof(ring->events[0]));
+    if(ring)
+        ring->mask = size - 1;
+    return ring;
+}
+
+void uadi_trace_ring_destroy(struct uadi_trace_ring* ring)
+{
+    uadi_aligned_free(ring);
+}
+
+void uadi_trace_clock_sample(struct uadi_trace_clock* clock)
+{
+    struct timespec ts;
+    clock->ticks = uadi_trace_ticks();
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    clock->ns = (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+size_t uadi_trace_snapshot(struct uadi_trace_ring const* ring, struct uadi_trace_event* events)
+{
+    unsigned long long capacity = ring->mask + 1;
+    unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    unsigned long long begin = head > capacity ? head - capacity : 0;
+    unsigned long long overwritten;
+    unsigned long long i;
+
+    for(i = begin; i < head; ++i)
+        memcpy(&events[i - begin], &ring->events[i & ring->mask], sizeof(*events));
+
+    /* The owner may have wrapped around while copying, everything it could
+     * have written since is dropped. */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    overwritten = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    overwritten = overwritten > capacity ? overwritten - capacity : 0;
+    if(overwritten <= begin)
+        return (size_t)(head - begin);
+    if(overwritten >= head)
+        return 0;
+    memmove(events, events + (overwritten - begin),
+            (size_t)(head - overwritten) * sizeof(*events));
+    return (size_t)(head - overwritten);
+}
+
+/* Chunk state left and entered by each event type, NULL for none. */
+static char const* const state_left[] = {
+    "consumer", "free ring", "filling", "filled", "callback", "free ring",
+};
+static char const* const state_entered[] = {
+    "free ring", "filling", "filled", "callback", "consumer", NULL,
+};
+
+static void write_async(FILE* out, char const* name, char phase, void const* chunk,
+                        double ts, int pid, int tid, unsigned long long sequence, int* first)
+{
+    fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"chunk\",\"ph\":\"%c\",\"id\":\"%p\","
+                 "\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"sequence\":%llu}}",
+            *first ? "" : ",", name, phase, chunk, ts, pid, tid, sequence);
+    *first = 0;
+}
+
+void uadi_trace_write_events(FILE* out, struct uadi_trace_event const* events, size_t count,
+                             int pid, int tid, struct uadi_trace_clock const* origin,
+                             double ns_per_tick, int* first)
+{
+    size_t i;
+    for(i = 0; i < count; ++i){
+        struct uadi_trace_event const* event = &events[i];
+        double ts = ((double)event->ticks - (double)origin->ticks) * ns_per_tick / 1000.0;
+        if(event->type > UADI_TRACE_RETURN)
+            continue;
+        write_async(out, state_left[event->type], 'e', event->chunk, ts, pid, tid,
+                    event->sequence, first);
+        if(state_entered[event->type])
+            write_async(out, state_entered[event->type], 'b', event->chunk, ts, pid, tid,
+                        event->sequence, first);
+    }
+}
+
+void uadi_trace_write_name(FILE* out, int pid, int tid, char const* name, int* first)
+{
+    fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",", tid < 0 ? "process_name" : "thread_name", pid, tid < 0 ? 0 : tid, name);
+    *first = 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file UaDI_trace.h
+ * @brief Internal chunk lifetime tracing.
+ *
+ * Every thread touching a chunk of a device records its state transitions
+ * into a binary ring only that thread writes to: the consumer pushing chunks,
+ * the producer filling them and the thread running the receive callback. A
+ * record is a raw timestamp counter value, the chunk and the sequence number,
+ * the rings are converted to the Chrome trace event format only when the
+ * trace is exported. A device without tracing has no rings, which leaves a
+ * well predicted NULL check per tracepoint.
+ */
+
+#ifndef UADI_TRACE_H
+#define UADI_TRACE_H
+
+#include "UaDI_memory.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/* Threads writing a trace ring of a device */
+enum uadi_trace_writer{
+    UADI_TRACE_CONSUMER,
+    UADI_TRACE_PRODUCER,
+    UADI_TRACE_DELIVERY,
+    UADI_TRACE_WRITERS
+};
+
+/* Chunk state transitions */
+enum uadi_trace_type{
+    UADI_TRACE_PUSH,           // consumer -> free ring
+    UADI_TRACE_FILL_BEGIN,     // free ring -> filling
+    UADI_TRACE_FILL_END,       // filling -> filled, waiting for delivery
+    UADI_TRACE_CALLBACK_BEGIN, // filled -> in the receive callback
+    UADI_TRACE_CALLBACK_END,   // callback returned -> with the consumer
+    UADI_TRACE_RETURN          // free ring -> returned unused on release
+};
+
+struct uadi_trace_event{
+    unsigned long long ticks;
+    void const* chunk;
+    unsigned long long sequence;
+    unsigned int type;
+};
+
+struct uadi_trace_ring{
+    UADI_CACHE_ALIGNED unsigned long long head; /* events ever recorded */
+    size_t mask;
+    UADI_CACHE_ALIGNED struct uadi_trace_event events[];
+};
+
+/* Pair of a timestamp counter value and CLOCK_MONOTONIC taken together, two
+ * of them convert ticks to nanoseconds. */
+struct uadi_trace_clock{
+    unsigned long long ticks;
+    unsigned long long ns;
+};
+
+/* Timestamp counter, the TSC on x86 and CLOCK_MONOTONIC in ns elsewhere.
+ * Converting TSC ticks assumes an invariant TSC, as on every x86 CPU of the
+ * last decade. */
+static inline unsigned long long uadi_trace_ticks(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+/* Records an event. Only the thread owning the ring may call this. */
+static inline void uadi_trace_record(struct uadi_trace_ring* ring, unsigned int type,
+                                     void const* chunk, unsigned long long sequence)
+{
+    unsigned long long head = ring->head;
+    struct uadi_trace_event* event = &ring->events[head & ring->mask];
+    event->ticks = uadi_trace_ticks();
+    event->chunk = chunk;
+    event->sequence = sequence;
+    event->type = type;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Tracepoint, costs a single branch when the ring is NULL. */
+#define UADI_TRACE(ring, type, chunk, sequence)                          \
+    do{                                                                  \
+        if(__builtin_expect((ring) != NULL, 0))                          \
+            uadi_trace_record((ring), (type), (chunk), (sequence));      \
+    }while(0)
+
+/* Ring holding the last capacity events, capacity is rounded up to a power of
+ * two. Returns NULL when out of memory. */
+struct uadi_trace_ring* uadi_trace_ring_create(size_t capacity);
+void uadi_trace_ring_destroy(struct uadi_trace_ring* ring);
+
+void uadi_trace_clock_sample(struct uadi_trace_clock* clock);
+
+/* Copies the events of a ring oldest first into events, which has room for
+ * the capacity of the ring, while the owner keeps recording. Events that were
+ * overwritten during the copy are dropped. Returns the number of events. */
+size_t uadi_trace_snapshot(struct uadi_trace_ring const* ring, struct uadi_trace_event* events);
+
+/* Writes events as Chrome trace asynchronous events, one track per chunk, to
+ * out. Timestamps are relative to origin. Every event is preceded by a comma
+ * unless *first is set, which is cleared afterwards. */
+void uadi_trace_write_events(FILE* out, struct uadi_trace_event const* events, size_t count,
+                             int pid, int tid, struct uadi_trace_clock const* origin,
+                             double ns_per_tick, int* first);
+
+/* Writes the metadata event naming a process (tid < 0) or thread. */
+void uadi_trace_write_name(FILE* out, int pid, int tid, char const* name, int* first);
+
+#endif // UADI_TRACE_H
@@ -0,0 +1,144 @@
+/**
+ * @file UaDI_wheel.c
+ * @brief Hierarchical timing wheel.
+ */
+
+#include "UaDI_wheel.h"
+
+#include <string.h>
+
+#define SLOT_MASK (UADI_WHEEL_SLOTS - 1)
+
+void uadi_wheel_init(struct uadi_wheel* wheel, unsigned long long now)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now;
+}
+
+static void link_timer(struct uadi_wheel* wheel, struct uadi_timer* timer, int level, int slot)
+{
+    struct uadi_timer** head = &wheel->slots[level][slot];
+    timer->level = level;
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = *head;
+    if(*head)
+        (*head)->prev = timer;
+    *head = timer;
+    wheel->occupied[level] |= 1ull << slot;
+}
+
+void uadi_wheel_add(struct uadi_wheel* wheel, struct uadi_timer* timer)
+{
+    unsigned long long expiry = timer->expiry > wheel->now ? timer->expiry : wheel->now;
+    unsigned long long delta = expiry - wheel->now;
+    int level = 0;
+
+    while(level < UADI_WHEEL_LEVELS - 1
+          && delta >= 1ull << (UADI_WHEEL_SLOT_BITS * (level + 1)))
+        ++level;
+    if(delta >= 1ull << (UADI_WHEEL_SLOT_BITS * UADI_WHEEL_LEVELS))
+        expiry = wheel->now + (1ull << (UADI_WHEEL_SLOT_BITS * UADI_WHEEL_LEVELS)) - 1;
+    link_timer(wheel, timer, level,
+               (int)((expiry >> (UADI_WHEEL_SLOT_BITS * level)) & SLOT_MASK));
+    ++wheel->count;
+}
+
+void uadi_wheel_remove(struct uadi_wheel* wheel, struct uadi_timer* timer)
+{
+    if(timer->prev)
+        timer->prev->next = timer->next;
+    else
+        wheel->slots[timer->level][timer->slot] = timer->next;
+    if(timer->next)
+        timer->next->prev = timer->prev;
+    if(!wheel->slots[timer->level][timer->slot])
+        wheel->occupied[timer->level] &= ~(1ull << timer->slot);
+    timer->next = timer->prev = NULL;
+    --wheel->count;
+}
+
+static struct uadi_timer* take_slot(struct uadi_wheel* wheel, int level, int slot)
+{
+    struct uadi_timer* list = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ull << slot);
+    return list;
+}
+
+/* Moves the timers of the slot of level that is current at wheel->now one
+ * level down, after the level below completed a revolution. */
+static void cascade(struct uadi_wheel* wheel, int level)
+{
+    int slot = (int)((wheel->now >> (UADI_WHEEL_SLOT_BITS * level)) & SLOT_MASK);
+    struct uadi_timer* timer = take_slot(wheel, level, slot);
+    struct uadi_timer* next;
+
+    if(slot == 0 && level + 1 < UADI_WHEEL_LEVELS)
+        cascade(wheel, level + 1);
+    for(; timer; timer = next){
+        next = timer->next;
+        --wheel->count;
+        uadi_wheel_add(wheel, timer);
+    }
+}
+
+struct uadi_timer* uadi_wheel_advance(struct uadi_wheel* wheel, unsigned long long now)
+{
+    struct uadi_timer* expired = NULL;
+    struct uadi_timer** tail = &expired;
+    struct uadi_timer* timer;
+    struct uadi_timer* next;
+    int slot;
+
+    for(; wheel->now <= now; ++wheel->now){
+        if(!wheel->count)
+            break;
+        slot = (int)(wheel->now & SLOT_MASK);
+        if(slot == 0)
+            cascade(wheel, 1);
+        if(!(wheel->occupied[0] & (1ull << slot)))
+            continue;
+        for(timer = take_slot(wheel, 0, slot); timer; timer = next){
+            next = timer->next;
+            --wheel->count;
+            if(timer->expiry > wheel->now){
+                /* Clamped to the range of the wheel when it was added. */
+                uadi_wheel_add(wheel, timer);
+                continue;
+            }
+            timer->prev = NULL;
+            timer->next = NULL;
+            *tail = timer;
+            tail = &timer->next;
+        }
+    }
+    if(wheel->now <= now)
+        wheel->now = now + 1;
+    return expired;
+}
+
+unsigned long long uadi_wheel_next_expiry(struct uadi_wheel const* wheel)
+{
+    unsigned long long occupied = wheel->occupied[0];
+    unsigned long long next = UADI_WHEEL_NEVER;
+    int offset = (int)(wheel->now & SLOT_MASK);
+    int level;
+
+    if(!wheel->count)
+        return UADI_WHEEL_NEVER;
+    if(occupied){
+        /* Rotate the mask so bit 0 is the current slot. */
+        occupied = offset ? (occupied >> offset) | (occupied << (UADI_WHEEL_SLOTS - offset))
+                          : occupied;
+        next = wheel->now + (unsigned long long)__builtin_ctzll(occupied);
+    }
+    /* The next cascade may bring down timers expiring earlier than that. */
+    for(level = 1; level < UADI_WHEEL_LEVELS; ++level){
+        if(wheel->occupied[level]){
+            unsigned long long cascade = (wheel->now + SLOT_MASK) & ~(unsigned long long)SLOT_MASK;
+            return cascade < next ? cascade : next;
+        }
+    }
+    return next;
+}
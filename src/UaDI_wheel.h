@@ -0,0 +1,55 @@
+/**
+ * @file UaDI_wheel.h
+ * @brief Internal hierarchical timing wheel.
+ *
+ * Four levels of 64 slots each, level n holding timers that expire within
+ * 64^(n+1) ticks. Adding and removing a timer is O(1). A timer moves down one
+ * level each time the level below completes a revolution, so it is touched
+ * at most four times before it expires. An occupancy mask per level makes
+ * finding the next expiry cheap. Timers further out than 64^4 ticks are kept
+ * in the last level and re-inserted until they are due.
+ * The wheel itself isn't thread safe.
+ */
+
+#ifndef UADI_WHEEL_H
+#define UADI_WHEEL_H
+
+#define UADI_WHEEL_LEVELS 4
+#define UADI_WHEEL_SLOT_BITS 6
+#define UADI_WHEEL_SLOTS (1 << UADI_WHEEL_SLOT_BITS)
+
+/* Returned by uadi_wheel_next_expiry(...) for an empty wheel. */
+#define UADI_WHEEL_NEVER (~0ull)
+
+struct uadi_timer{
+    struct uadi_timer* next;
+    struct uadi_timer* prev;
+    unsigned long long expiry; /* in ticks */
+    int level;
+    int slot;
+};
+
+struct uadi_wheel{
+    unsigned long long now; /* every tick before now has been processed */
+    unsigned long long occupied[UADI_WHEEL_LEVELS];
+    struct uadi_timer* slots[UADI_WHEEL_LEVELS][UADI_WHEEL_SLOTS];
+    unsigned long long count;
+};
+
+void uadi_wheel_init(struct uadi_wheel* wheel, unsigned long long now);
+
+/* Adds a timer expiring at timer->expiry. Expiries in the past expire with
+ * the next call to uadi_wheel_advance(...). */
+void uadi_wheel_add(struct uadi_wheel* wheel, struct uadi_timer* timer);
+void uadi_wheel_remove(struct uadi_wheel* wheel, struct uadi_timer* timer);
+
+/* Processes every tick up to and including now and returns the timers that
+ * expired, linked through next, in order of expiry. */
+struct uadi_timer* uadi_wheel_advance(struct uadi_wheel* wheel, unsigned long long now);
+
+/* Tick by which uadi_wheel_advance(...) has to be called next. Exact for
+ * timers expiring within the current revolution of the first level, earlier
+ * than necessary otherwise. */
+unsigned long long uadi_wheel_next_expiry(struct uadi_wheel const* wheel);
+
+#endif // UADI_WHEEL_H
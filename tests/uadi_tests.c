@@ -0,0 +1,470 @@
+/**
+ * @file uadi_tests.c
+ * @brief Table driven checks of the internal JSON parser, expression
+ * compiler, processing pipeline and CRC32C kernels.
+ *
+ * Usage: uadi_tests json|expression|pipeline|crc32c
+ * The kernel selection honours UADI_ISA, so ctest runs the kernel dependent
+ * checks once per level; levels the CPU lacks fall back to the best one it
+ * has.
+ */
+
+#include "UaDI_expression.h"
+#include "UaDI_json.h"
+#include "UaDI_kernels.h"
+#include "UaDI_pipeline.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(int condition, char const* text, char const* file, int line)
+{
+    if(condition)
+        return;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, text);
+    ++failures;
+}
+
+static int near_within(double a, double b, double tolerance)
+{
+    return fabs(a - b) <= tolerance * (1.0 + fabs(b));
+}
+
+static int near(double a, double b)
+{
+    return near_within(a, b, 1e-5);
+}
+
+/* JSON */
+
+struct json_case{
+    char const* text;
+    int valid;
+};
+
+static struct json_case const json_cases[] = {
+    {"{}", 1},
+    {" [1, -2.5e3, true, false, null, \"s\", {\"a\": []}] ", 1},
+    {"{\"a\":1,}", 0},
+    {"[1 2]", 0},
+    {"{\"a\" 1}", 0},
+    {"01", 0},
+    {"1.", 0},
+    {".5", 0},
+    {"-", 0},
+    {"1e", 0},
+    {"0x10", 0},
+    {"\"unterminated", 0},
+    {"\"bad \\q escape\"", 0},
+    {"\"\\ud800\"", 0},
+    {"{} trailing", 0},
+    {"", 0},
+};
+
+struct json_number_case{
+    char const* text;
+    double value;
+};
+
+static struct json_number_case const json_number_cases[] = {
+    {"0", 0.0},
+    {"-0.125e2", -12.5},
+    {"2.5", 2.5},
+    {"1E+3", 1000.0},
+    {"123456789", 123456789.0},
+};
+
+static void test_json(void)
+{
+    struct uadi_json* json;
+    char text[256];
+    char deep[200];
+    double number;
+    size_t i;
+
+    for(i = 0; i < sizeof(json_cases) / sizeof(json_cases[0]); ++i){
+        json = uadi_json_parse(json_cases[i].text);
+        if((json != NULL) != json_cases[i].valid)
+            fprintf(stderr, "json case \"%s\"\n", json_cases[i].text);
+        CHECK((json != NULL) == json_cases[i].valid);
+        uadi_json_free(json);
+    }
+
+    for(i = 0; i < sizeof(json_number_cases) / sizeof(json_number_cases[0]); ++i){
+        snprintf(text, sizeof(text), "{\"n\":%s}", json_number_cases[i].text);
+        json = uadi_json_parse(text);
+        CHECK(json != NULL);
+        CHECK(uadi_json_number(json, "n", -1.0) == json_number_cases[i].value);
+        uadi_json_free(json);
+    }
+    CHECK(uadi_json_scan_number("2.5,", &number) && number == 2.5);
+    CHECK(uadi_json_scan_number("x", &number) == NULL);
+
+    json = uadi_json_parse("{\"s\":\"a\\u00e9\\ud83d\\ude00\\n\",\"n\":3,\"o\":{\"k\":true}}");
+    CHECK(json != NULL);
+    CHECK(strcmp(uadi_json_string(json, "s"), "a\xc3\xa9\xf0\x9f\x98\x80\n") == 0);
+    CHECK(uadi_json_string(json, "n") == NULL);
+    CHECK(uadi_json_number(json, "s", 7.0) == 7.0);
+    CHECK(uadi_json_number(json, "missing", 7.0) == 7.0);
+    CHECK(uadi_json_member(uadi_json_member(json, "o"), "k")->type == UADI_JSON_TRUE);
+    uadi_json_free(json);
+
+    /* 64 levels of nesting are accepted, 65 rejected. */
+    memset(deep, '[', 64);
+    memset(deep + 64, ']', 64);
+    deep[128] = '\0';
+    json = uadi_json_parse(deep);
+    CHECK(json != NULL);
+    uadi_json_free(json);
+    memset(deep, '[', 65);
+    memset(deep + 65, ']', 65);
+    deep[130] = '\0';
+    CHECK(uadi_json_parse(deep) == NULL);
+}
+
+/* Expressions */
+
+struct expression_case{
+    char const* text;
+    size_t channel_count;       /* 0 for invalid expressions */
+    float frames[2][2];
+    float results[2];
+};
+
+static char const* const expression_channels[] = {"a", "b"};
+
+static struct expression_case const expression_cases[] = {
+    {"a", 1, {{3.0f}, {-1.0f}}, {3.0f, -1.0f}},
+    {"2*a + 1", 1, {{3.0f}, {-1.0f}}, {7.0f, -1.0f}},
+    {"1 + a*2 - 3", 1, {{3.0f}, {-1.0f}}, {4.0f, -4.0f}},
+    {"-a/2", 1, {{3.0f}, {-1.0f}}, {-1.5f, 0.5f}},
+    {"2 - a", 1, {{3.0f}, {-1.0f}}, {-1.0f, 3.0f}},
+    {"1/a", 1, {{4.0f}, {-0.5f}}, {0.25f, -2.0f}},
+    {"abs(a) + sqrt(16)", 1, {{3.0f}, {-1.0f}}, {7.0f, 5.0f}},
+    {"clamp(2*a - 1, 0, 4)", 1, {{3.0f}, {-1.0f}}, {4.0f, 0.0f}},
+    {"sqrt(a*a + b*b)", 2, {{3.0f, 4.0f}, {-5.0f, 12.0f}}, {5.0f, 13.0f}},
+    {"min(a, b) - max(a, b)", 2, {{3.0f, 4.0f}, {-5.0f, 12.0f}}, {-1.0f, -17.0f}},
+    {"(a - b) * (a + b)", 2, {{3.0f, 4.0f}, {-5.0f, 12.0f}}, {-7.0f, -119.0f}},
+    {"a +", 0, {{0}}, {0}},
+    {"c", 0, {{0}}, {0}},
+    {"sqrt(a", 0, {{0}}, {0}},
+    {"min(a)", 0, {{0}}, {0}},
+    {"pow(a, 2)", 0, {{0}}, {0}},
+    {"a .5", 0, {{0}}, {0}},
+    {"", 0, {{0}}, {0}},
+};
+
+static void nested_sum(char* text, size_t levels)
+{
+    size_t n;
+    text[0] = '\0';
+    for(n = 1; n < levels; ++n)
+        strcat(text, "a+(");
+    strcat(text, "a");
+    for(n = 1; n < levels; ++n)
+        strcat(text, ")");
+}
+
+/* Value of a single channel expression for one frame, NaN if it doesn't
+ * compile. */
+static float evaluate(char const* text, float a)
+{
+    struct uadi_expression* expression;
+    float result;
+    if(uadi_expression_compile(text, expression_channels, 1, &expression) != UADI_SUCCESS)
+        return NAN;
+    uadi_expression_evaluate(expression, &result, &a, 1);
+    uadi_expression_destroy(expression);
+    return result;
+}
+
+static void test_expression(void)
+{
+    struct uadi_expression* expression;
+    float frames[4];
+    float results[2];
+    float many[1000];
+    char text[1024];
+    size_t i;
+    size_t n;
+
+    for(i = 0; i < sizeof(expression_cases) / sizeof(expression_cases[0]); ++i){
+        struct expression_case const* c = &expression_cases[i];
+        size_t channels = c->channel_count ? c->channel_count : 2;
+        uadi_status status = uadi_expression_compile(c->text, expression_channels, channels, &expression);
+        if((status == UADI_SUCCESS) != (c->channel_count != 0))
+            fprintf(stderr, "expression case \"%s\"\n", c->text);
+        CHECK((status == UADI_SUCCESS) == (c->channel_count != 0));
+        if(status != UADI_SUCCESS)
+            continue;
+        for(n = 0; n < 2; ++n)
+            memcpy(frames + n * channels, c->frames[n], channels * sizeof(float));
+        uadi_expression_evaluate(expression, results, frames, 2);
+        CHECK(near(results[0], c->results[0]) && near(results[1], c->results[1]));
+        uadi_expression_destroy(expression);
+    }
+
+    /* 200 constants only fit into 128 instructions when folded. */
+    strcpy(text, "a*(1");
+    for(n = 1; n < 200; ++n)
+        strcat(text, "+1");
+    strcat(text, ")");
+    CHECK(evaluate(text, 0.5f) == 100.0f);
+
+    /* So do 100 square roots of a constant, each folded into the sum. */
+    strcpy(text, "a");
+    for(n = 0; n < 100; ++n)
+        strcat(text, "+sqrt(4)");
+    CHECK(evaluate(text, 0.0f) == 200.0f);
+
+    /* 40 factors a*2+1 take 119 instructions with each fused into a scale
+     * instruction, 159 without. */
+    text[0] = '\0';
+    for(n = 0; n < 40; ++n)
+        strcat(text, n ? "*(a*2+1)" : "(a*2+1)");
+    CHECK(evaluate(text, 0.0f) == 1.0f);
+
+    /* Right nested sums a+(a+(...)) need a stack slot per level, at most 8. */
+    nested_sum(text, 8);
+    CHECK(evaluate(text, 1.0f) == 8.0f);
+    nested_sum(text, 9);
+    CHECK(isnan(evaluate(text, 1.0f)));
+
+    /* The interpreter runs blocks of frames, results cross block edges. */
+    for(n = 0; n < 1000; ++n)
+        many[n] = (float)n;
+    if(uadi_expression_compile("a*a - a", expression_channels, 1, &expression) == UADI_SUCCESS){
+        uadi_expression_evaluate(expression, many, many, 1000);
+        uadi_expression_destroy(expression);
+    }
+    for(n = 0; n < 1000 && many[n] == (float)(n * n - n); ++n)
+        ;
+    CHECK(n == 1000);
+}
+
+/* Pipeline */
+
+static struct uadi_pipeline* create_pipeline(char const* stages)
+{
+    struct uadi_json* json = uadi_json_parse(stages);
+    struct uadi_pipeline* pipeline = NULL;
+    if(!json || uadi_pipeline_create(json, &pipeline) != UADI_SUCCESS)
+        pipeline = NULL;
+    uadi_json_free(json);
+    return pipeline;
+}
+
+/* Runs count samples, value i at index i starting at first, through the
+ * pipeline as one chunk and returns the number of samples left. */
+static size_t run_chunk(struct uadi_pipeline* pipeline, float* samples, size_t first, size_t count,
+                        struct uadi_chunk_header* header)
+{
+    size_t i;
+    for(i = 0; i < count; ++i)
+        samples[i] = (float)(first + i);
+    memset(header, 0, sizeof(*header));
+    header->sample_count = (unsigned int)count;
+    header->data_size = count * sizeof(float);
+    uadi_pipeline_run(pipeline, samples, header);
+    CHECK(header->data_size == header->sample_count * sizeof(float));
+    return header->sample_count;
+}
+
+static char const* const invalid_pipelines[] = {
+    "{}",
+    "[{\"stage\":\"unknown\"}]",
+    "[{\"gain\":2}]",
+    "[{\"stage\":\"fir\"}]",
+    "[{\"stage\":\"fir\",\"taps\":[]}]",
+    "[{\"stage\":\"decimate\",\"factor\":0}]",
+    "[{\"stage\":\"decimate\",\"factor\":1.5}]",
+    "[{\"stage\":\"trigger\",\"edge\":\"both\"}]",
+    "[{\"stage\":\"expression\",\"expression\":\"y\"}]",
+};
+
+/* Chunk sizes crossing tile boundaries and splitting frames and
+ * decimation periods. */
+static size_t const chunk_sizes[] = {10001, 4097, 3, 8192, 1};
+
+static void test_pipeline(void)
+{
+    static float samples[3 * UADI_PIPELINE_TILE];
+    struct uadi_chunk_header header;
+    struct uadi_stage_statistics statistics[2];
+    struct uadi_pipeline* pipeline;
+    size_t first, kept, i, c;
+    int ok;
+
+    for(i = 0; i < sizeof(invalid_pipelines) / sizeof(invalid_pipelines[0]); ++i){
+        pipeline = create_pipeline(invalid_pipelines[i]);
+        CHECK(pipeline == NULL);
+        uadi_pipeline_destroy(pipeline);
+    }
+
+    /* scale and decimate keep every third sample, continuing the phase
+     * across chunks: the output is 2 * 3k + 1 for k = 0, 1, ... */
+    pipeline = create_pipeline("[{\"stage\":\"scale\",\"gain\":2,\"offset\":1},"
+                               "{\"stage\":\"decimate\",\"factor\":3}]");
+    CHECK(pipeline != NULL);
+    ok = 1;
+    for(first = 0, kept = 0, c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++c){
+        size_t count = run_chunk(pipeline, samples, first, chunk_sizes[c], &header);
+        for(i = 0; i < count; ++i)
+            ok &= samples[i] == (float)(6 * (kept + i) + 1);
+        first += chunk_sizes[c];
+        kept += count;
+    }
+    CHECK(ok);
+    CHECK(kept == (first + 2) / 3);
+    uadi_pipeline_destroy(pipeline);
+
+    /* A two tap moving sum carries its history across chunks. */
+    pipeline = create_pipeline("[{\"stage\":\"fir\",\"taps\":[1,1]}]");
+    CHECK(pipeline != NULL);
+    ok = 1;
+    for(first = 0, c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++c){
+        size_t count = run_chunk(pipeline, samples, first, chunk_sizes[c], &header);
+        CHECK(count == chunk_sizes[c]);
+        for(i = 0; i < count; ++i)
+            ok &= samples[i] == (float)(first + i + (first + i ? first + i - 1 : 0));
+        first += chunk_sizes[c];
+    }
+    CHECK(ok);
+    uadi_pipeline_destroy(pipeline);
+
+    /* Frames of two channels split across tiles and chunks: a - b of the
+     * frame (2k, 2k + 1) is -1, and a + b is 4k + 1. */
+    pipeline = create_pipeline("[{\"stage\":\"expression\",\"expression\":\"a + b\","
+                               "\"channels\":[\"a\",\"b\"]}]");
+    CHECK(pipeline != NULL);
+    ok = 1;
+    for(first = 0, kept = 0, c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++c){
+        size_t count = run_chunk(pipeline, samples, first, chunk_sizes[c], &header);
+        for(i = 0; i < count; ++i)
+            ok &= samples[i] == (float)(4 * (kept + i) + 1);
+        first += chunk_sizes[c];
+        kept += count;
+    }
+    CHECK(ok);
+    CHECK(kept == first / 2);
+    uadi_pipeline_destroy(pipeline);
+
+    /* statistics of one chunk, and a rising trigger at level 5000 */
+    pipeline = create_pipeline("[{\"stage\":\"statistics\"},"
+                               "{\"stage\":\"trigger\",\"level\":5000,\"edge\":\"rising\"}]");
+    CHECK(pipeline != NULL);
+    run_chunk(pipeline, samples, 0, 10001, &header);
+    CHECK(uadi_pipeline_statistics(pipeline, statistics, 2) == 2);
+    CHECK(strcmp(statistics[0].stage, "statistics") == 0);
+    CHECK(statistics[0].results[0] == 0.0 && statistics[0].results[1] == 10000.0);
+    /* The kernels sum floats per tile. */
+    CHECK(near_within(statistics[0].results[2], 5000.0, 1e-4));
+    CHECK(near_within(statistics[0].results[3], sqrt(10000.0 * 20001.0 / 6.0), 1e-4));
+    CHECK((header.flags & UADI_CHUNK_TRIGGERED) && header.trigger_sample == 5000);
+    run_chunk(pipeline, samples, 10001, 100, &header);
+    CHECK(!(header.flags & UADI_CHUNK_TRIGGERED));
+    uadi_pipeline_statistics(pipeline, statistics, 2);
+    CHECK(statistics[1].chunks == 2 && statistics[1].results[0] == 1.0);
+    uadi_pipeline_destroy(pipeline);
+}
+
+/* CRC32C */
+
+static unsigned int crc32c_bitwise(unsigned int crc, unsigned char const* data, size_t size)
+{
+    int k;
+    crc = ~crc;
+    while(size--){
+        crc ^= *data++;
+        for(k = 0; k < 8; ++k)
+            crc = crc & 1u ? (crc >> 1) ^ 0x82f63b78u : crc >> 1;
+    }
+    return ~crc;
+}
+
+struct crc32c_case{
+    char const* data;
+    size_t size;
+    unsigned int crc;
+};
+
+/* Check values from RFC 3720, B.4 */
+static struct crc32c_case const crc32c_cases[] = {
+    {"123456789", 9, 0xe3069283u},
+    {"", 0, 0x00000000u},
+    {"\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 32, 0x8a9136aau},
+    {"\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+     "\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff", 32, 0x62a8ab43u},
+};
+
+/* Sizes around the block lengths of the three stream variant */
+static size_t const crc32c_sizes[] = {
+    1, 7, 8, 63, 767, 768, 769, 3 * 8192 - 1, 3 * 8192, 3 * 8192 + 3 * 256 + 13, 131072, 200003,
+};
+
+static void test_crc32c(void)
+{
+    static unsigned char data[200003 + 8];
+    unsigned int seed = 1;
+    size_t i, offset, split;
+
+    uadi_kernels_init();
+    printf("crc32c with the %s kernels\n", uadi_isa_name(uadi_kernels.isa));
+    for(i = 0; i < sizeof(crc32c_cases) / sizeof(crc32c_cases[0]); ++i)
+        CHECK(uadi_kernels.crc32c(0, crc32c_cases[i].data, crc32c_cases[i].size) == crc32c_cases[i].crc);
+
+    for(i = 0; i < sizeof(data); ++i){
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (unsigned char)(seed >> 16);
+    }
+    for(i = 0; i < sizeof(crc32c_sizes) / sizeof(crc32c_sizes[0]); ++i){
+        size_t size = crc32c_sizes[i];
+        for(offset = 0; offset < 8; offset += 3){
+            unsigned int expected = crc32c_bitwise(0, data + offset, size);
+            CHECK(uadi_kernels.crc32c(0, data + offset, size) == expected);
+            /* Continuing a CRC gives the CRC of the concatenation. */
+            split = size / 3;
+            CHECK(uadi_kernels.crc32c(uadi_kernels.crc32c(0, data + offset, split),
+                                      data + offset + split, size - split) == expected);
+        }
+    }
+}
+
+struct test{
+    char const* name;
+    void (*run)(void);
+};
+
+static struct test const tests[] = {
+    {"json", test_json},
+    {"expression", test_expression},
+    {"pipeline", test_pipeline},
+    {"crc32c", test_crc32c},
+};
+
+int main(int argc, char** argv)
+{
+    size_t i;
+    int ran = 0;
+
+    uadi_kernels_init();
+    for(i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i){
+        if(argc > 1 && strcmp(argv[1], tests[i].name) != 0)
+            continue;
+        tests[i].run();
+        ran = 1;
+    }
+    if(!ran){
+        fprintf(stderr, "usage: %s [json|expression|pipeline|crc32c]\n", argv[0]);
+        return 2;
+    }
+    if(failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}